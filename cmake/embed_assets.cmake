@@ -0,0 +1,59 @@
+# Turns asset files into a header of constexpr strings so the game needs no
+# files at startup. Shaders can #include "file" another file from the same
+# directory, includes are pasted in here so the embedded text is complete.
+#
+# usage: cmake -DASSET_DIR=<dir> -DASSETS="a;b" -DOUTPUT=<header> -P embed_assets.cmake
+
+if(NOT ASSET_DIR OR NOT ASSETS OR NOT OUTPUT)
+  message(FATAL_ERROR "ASSET_DIR, ASSETS and OUTPUT are required")
+endif()
+
+set(delimiter "GEASSET")
+
+# reads path with every #include "name" replaced by name's resolved contents
+function(resolve_includes path depth out)
+  if(depth GREATER 16)
+    message(FATAL_ERROR "#include nested too deep at ${path}")
+  endif()
+  if(NOT EXISTS "${path}")
+    message(FATAL_ERROR "missing asset ${path}")
+  endif()
+  file(READ "${path}" content)
+  string(REGEX MATCHALL "#include[ \t]+\"[^\"]+\"" directives "${content}")
+  if(directives)
+    list(REMOVE_DUPLICATES directives)
+  endif()
+  foreach(directive ${directives})
+    string(REGEX REPLACE "#include[ \t]+\"([^\"]+)\"" "\\1" name "${directive}")
+    math(EXPR next "${depth} + 1")
+    resolve_includes("${ASSET_DIR}/${name}" ${next} included)
+    string(REPLACE "${directive}" "${included}" content "${content}")
+  endforeach()
+  set(${out} "${content}" PARENT_SCOPE)
+endfunction()
+
+set(header "// generated by cmake/embed_assets.cmake from ${ASSET_DIR}, don't edit\n")
+string(APPEND header "#ifndef EMBEDDED_ASSETS_H\n#define EMBEDDED_ASSETS_H\n\n#include <cstddef>\n\n")
+string(APPEND header "struct EmbeddedAsset {\n  const char *name;\n  const char *data;\n  size_t size;\n};\n\n")
+set(table "")
+set(index 0)
+foreach(asset ${ASSETS})
+  resolve_includes("${ASSET_DIR}/${asset}" 0 content)
+  string(FIND "${content}" ")${delimiter}\"" clash)
+  if(NOT clash EQUAL -1)
+    message(FATAL_ERROR "${asset} contains the raw string delimiter")
+  endif()
+  string(APPEND header "// ${asset}\nconstexpr char embeddedAsset${index}[] = R\"${delimiter}(${content})${delimiter}\";\n\n")
+  string(APPEND table "  {\"${asset}\", embeddedAsset${index}, sizeof(embeddedAsset${index}) - 1},\n")
+  math(EXPR index "${index} + 1")
+endforeach()
+string(APPEND header "constexpr EmbeddedAsset embeddedAssets[] = {\n${table}};\n\n#endif\n")
+
+# only touch the header when it changed, so nothing rebuilds for nothing
+set(existing "")
+if(EXISTS "${OUTPUT}")
+  file(READ "${OUTPUT}" existing)
+endif()
+if(NOT existing STREQUAL header)
+  file(WRITE "${OUTPUT}" "${header}")
+endif()
@@ -0,0 +1,298 @@
+// Runs the course generator and the player simulation without a window or a
+// GL context, driven by a scripted input stream, and reports how fast it goes.
+//
+// usage: Headless [--ticks N] [--seed N] [--endless] [--record demo]
+//                 [--course file] [--save-course file] [--voxel grid] [script]
+//        Headless --replay demo
+//
+// Each script line is "<ticks> <keys> [yaw per tick]", where keys is any of
+// w, a, s, d and j (jump) or - for none. The script loops until --ticks have
+// run. Without a script the player holds forward and jump while turning.
+// --record saves every tick of the run as a demo, --replay re-simulates one.
+// --endless runs on a streamed course that never finishes. --save-course
+// writes the generated course as a binary course file, --course maps one
+// instead of generating. --voxel runs in a walled grid like include/map.txt.
+
+#include "include/alloc_counter.h"
+#include "include/course.h"
+#include "include/course_file.h"
+#include "include/demo.h"
+#include "include/frustum.h"
+#include "include/reachability.h"
+#include "include/simulation.h"
+#include "include/streaming_course.h"
+#include "include/voxel_world.h"
+#include "include/glm/gtc/matrix_transform.hpp"
+
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+struct ScriptStep {
+  uint32_t ticks;
+  TickInput input;
+  float yawPerTick;
+};
+
+bool parse_script(std::istream &in, std::vector<ScriptStep> &steps) {
+  std::string line;
+  while (std::getline(in, line)) {
+    if (line.empty() || line[0] == '#') continue;
+    std::istringstream fields(line);
+    ScriptStep step{};
+    std::string keys;
+    if (!(fields >> step.ticks >> keys)) {
+      std::cout << "bad script line: " << line << std::endl;
+      return false;
+    }
+    fields >> step.yawPerTick;
+    step.yawPerTick = quantize_angle(step.yawPerTick) / angleUnits;
+    for (char key : keys) {
+      switch (key) {
+        case 'w': step.input.forward = true; break;
+        case 's': step.input.back = true; break;
+        case 'a': step.input.left = true; break;
+        case 'd': step.input.right = true; break;
+        case 'j': step.input.jump = true; break;
+        case '-': break;
+        default:
+          std::cout << "unknown key '" << key << "' in script" << std::endl;
+          return false;
+      }
+    }
+    steps.push_back(step);
+  }
+  return !steps.empty();
+}
+
+int main(int argc, char **argv) {
+  uint64_t ticks = 1000000;
+  std::random_device rd;
+  uint64_t seed = static_cast<uint64_t>(rd()) << 32 | rd();
+  const char *scriptPath = nullptr;
+  const char *recordPath = nullptr;
+  const char *replayPath = nullptr;
+  const char *coursePath = nullptr;
+  const char *saveCoursePath = nullptr;
+  const char *voxelPath = nullptr;
+  bool endless = false;
+  for (int i = 1; i < argc; ++i) {
+    std::string arg = argv[i];
+    if (arg == "--ticks" && i + 1 < argc)
+      ticks = std::strtoull(argv[++i], nullptr, 10);
+    else if (arg == "--seed" && i + 1 < argc)
+      seed = std::strtoull(argv[++i], nullptr, 10);
+    else if (arg == "--record" && i + 1 < argc)
+      recordPath = argv[++i];
+    else if (arg == "--replay" && i + 1 < argc)
+      replayPath = argv[++i];
+    else if (arg == "--endless")
+      endless = true;
+    else if (arg == "--course" && i + 1 < argc)
+      coursePath = argv[++i];
+    else if (arg == "--save-course" && i + 1 < argc)
+      saveCoursePath = argv[++i];
+    else if (arg == "--voxel" && i + 1 < argc)
+      voxelPath = argv[++i];
+    else if (arg[0] != '-')
+      scriptPath = argv[i];
+    else {
+      std::cout << "usage: " << argv[0] << " [--ticks N] [--seed N] [--endless] [--record demo]\n"
+                << "                [--course file] [--save-course file] [--voxel grid] [script]\n"
+                << "       " << argv[0] << " --replay demo" << std::endl;
+      return 1;
+    }
+  }
+
+  if (endless && (recordPath || replayPath || coursePath || saveCoursePath)) {
+    std::cout << "endless runs can't be recorded, replayed or saved" << std::endl;
+    return 1;
+  }
+  if (coursePath && saveCoursePath) {
+    std::cout << "--course and --save-course don't go together" << std::endl;
+    return 1;
+  }
+  if (voxelPath && (endless || recordPath || replayPath || coursePath || saveCoursePath)) {
+    std::cout << "voxel runs can't be endless, recorded, replayed or saved" << std::endl;
+    return 1;
+  }
+
+  PhysicsParams physics;
+  CourseParams courseParams;
+  DemoReader replay;
+  if (replayPath) {
+    if (!replay.load(replayPath)) {
+      std::cout << "failed to read demo " << replayPath << std::endl;
+      return 1;
+    }
+    seed = replay.info.seed;
+    courseParams = replay.info.course;
+    physics = replay.info.physics;
+    ticks = replay.info.ticks;
+  }
+
+  auto loadStart = std::chrono::steady_clock::now();
+  MappedCourse mapped;
+  if (coursePath) {
+    if (!mapped.open(coursePath)) {
+      std::cout << "failed to map course " << coursePath << std::endl;
+      return 1;
+    }
+    if (replayPath && (mapped.seed() != seed || !same_course_params(mapped.params(), courseParams))) {
+      std::cout << "the demo was recorded on a different course" << std::endl;
+      return 1;
+    }
+    seed = mapped.seed();
+    courseParams = mapped.params();
+  }
+
+  std::vector<ScriptStep> script;
+  if (scriptPath) {
+    std::ifstream file(scriptPath);
+    if (!file || !parse_script(file, script)) {
+      std::cout << "failed to read script " << scriptPath << std::endl;
+      return 1;
+    }
+  } else {
+    ScriptStep step{};
+    step.ticks = 1;
+    step.input.forward = true;
+    step.input.jump = true;
+    step.yawPerTick = 0.5f;
+    script.push_back(step);
+  }
+
+  std::unique_ptr<Course> course;
+  std::unique_ptr<StreamingCourse> stream;
+  VoxelWorld voxels;
+  std::vector<AABB> voxelBoxes;
+  const World *world = &mapped;
+  size_t platformCount = coursePath ? mapped.platform_count() : 0;
+  if (voxelPath) {
+    if (!voxels.load(voxelPath)) {
+      std::cout << "failed to read voxel grid " << voxelPath << std::endl;
+      return 1;
+    }
+    world = &voxels;
+    voxelBoxes = voxels.greedy_mesh();
+    platformCount = voxelBoxes.size();
+  } else if (endless) {
+    stream = std::make_unique<StreamingCourse>(seed, courseParams, physics.playerSize);
+    world = stream.get();
+    platformCount = stream->size();
+  } else if (!coursePath) {
+    course = std::make_unique<Course>(generate_course(seed, courseParams, physics.playerSize));
+    world = course.get();
+    platformCount = course->platformPositions.size();
+  }
+  double loadSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - loadStart).count();
+  if (saveCoursePath && !save_course(*course, saveCoursePath)) {
+    std::cout << "failed to write course " << saveCoursePath << std::endl;
+    return 1;
+  }
+  Simulation sim(*world, physics);
+  DemoWriter demo(seed, courseParams, physics);
+
+  uint64_t finishes = 0, respawns = 0;
+  TickInput lastInput;
+  float yaw = TickInput().yaw;
+  size_t step = 0;
+  uint32_t stepTick = 0;
+  size_t allocationsBefore = heapAllocations;
+  auto start = std::chrono::steady_clock::now();
+  for (uint64_t tick = 0; tick < ticks; ++tick) {
+    if (stepTick == script[step].ticks) {
+      stepTick = 0;
+      step = (step + 1) % script.size();
+    }
+    ++stepTick;
+
+    TickInput input = script[step].input;
+    yaw += script[step].yawPerTick;
+    input.yaw = yaw;
+    if (replayPath && !replay.next(input)) {
+      std::cout << "demo ended early, it's corrupt" << std::endl;
+      return 1;
+    }
+    quantize_angles(input);
+    lastInput = input;
+    if (recordPath)
+      demo.record(input);
+    switch (sim.tick(input)) {
+      case TickEvent::Finish: ++finishes; break;
+      case TickEvent::Respawn: ++respawns; break;
+      case TickEvent::None: break;
+    }
+    glm::vec3 shift;
+    if (endless && stream->advance(sim.lastPlatform, shift))
+      sim.shift_origin(shift);
+  }
+  auto end = std::chrono::steady_clock::now();
+  size_t tickAllocations = heapAllocations - allocationsBefore;
+
+  double seconds = std::chrono::duration<double>(end - start).count();
+
+  // cull what the game would draw from the final view, the same bounds and
+  // projection as a frame in main.cpp
+  std::vector<AABB> drawnBounds(platformCount);
+  for (size_t i = 0; i < platformCount; ++i) {
+    if (voxelPath) {
+      drawnBounds[i] = voxelBoxes[i];
+      continue;
+    }
+    glm::vec3 scale = endless ? stream->platformScale : coursePath ? mapped.platform_scale() : course->platformScale;
+    glm::vec3 pos = endless ? stream->platform(i) : coursePath ? mapped.platform_positions()[i] : course->platformPositions[i];
+    drawnBounds[i] = aabb_from_center(pos * scale, scale);
+  }
+  FrustumCuller culler;
+  culler.set_boxes(drawnBounds.data(), platformCount);
+  float yawRad = glm::radians(lastInput.yaw), pitchRad = glm::radians(lastInput.pitch);
+  glm::vec3 front(std::cos(yawRad) * std::cos(pitchRad), std::sin(pitchRad), std::sin(yawRad) * std::cos(pitchRad));
+  glm::mat4 view = glm::lookAt(sim.cameraPos, sim.cameraPos + front, glm::vec3(0.0f, 1.0f, 0.0f));
+  glm::mat4 projection = glm::perspective(glm::radians(90.0f), 800.0f / 600.0f, 0.1f, 100.0f);
+  std::vector<uint32_t> visible;
+  auto cullStart = std::chrono::steady_clock::now();
+  size_t visibleCount = culler.cull(frustum_from_matrix(projection * view), visible);
+  double cullSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - cullStart).count();
+
+  ReachabilityAnalyzer reachability(physics, courseParams);
+  bool finishable = endless || voxelPath || reachability.analyze(seed);
+  if (voxelPath)
+    std::cout << "grid: " << voxels.grid_width() << "x" << voxels.grid_height() << ", "
+              << platformCount << " boxes after greedy meshing (loaded in " << loadSeconds * 1e6 << " us)\n";
+  else
+    std::cout << "seed: " << seed << "\n"
+              << "platforms: " << platformCount << (endless ? " alive" : "")
+              << (coursePath ? " (mapped in " : " (generated in ") << loadSeconds * 1e6 << " us)\n";
+  if (!endless && !voxelPath) {
+    std::cout << "finishable: " << (finishable ? "yes" : "no");
+    if (reachability.unreachable())
+      std::cout << ", " << reachability.unreachable() << " unreachable from platform " << reachability.first_unreachable();
+    std::cout << "\n";
+  }
+  std::cout << "ticks: " << ticks << " (" << ticks / physics.tickRate << " s of game time)\n"
+            << "wall time: " << seconds << " s\n"
+            << "ticks/s: " << (seconds > 0.0 ? ticks / seconds : 0.0) << "\n"
+            << "finishes: " << finishes << ", respawns: " << respawns << "\n";
+  if (endless)
+    std::cout << "checkpoints: " << stream->checkpoints << "\n";
+  std::cout << "final view: " << visibleCount << " visible, " << platformCount - visibleCount << " culled in "
+            << cullSeconds * 1e6 << " us on " << (platformCount >= FrustumCuller::parallelThreshold ? culler.threads : 1)
+            << " threads\n"
+            << "heap allocations during ticks: " << tickAllocations << "\n"
+            << "final position: " << sim.cameraPos.x << " " << sim.cameraPos.y << " " << sim.cameraPos.z << std::endl;
+
+  if (recordPath && !demo.save(recordPath)) {
+    std::cout << "failed to write demo " << recordPath << std::endl;
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,80 @@
+#ifndef AABB_H
+#define AABB_H
+
+#include "glm/glm.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+
+// axis-aligned bounding box, bounds are inclusive
+struct AABB {
+  glm::vec3 min;
+  glm::vec3 max;
+};
+
+// first box a ray or sweep runs into
+struct BVHHit {
+  float t;          // fraction of the ray/sweep where the hit happens
+  uint32_t id;      // which box, as the world that was queried numbers them
+  glm::vec3 normal; // face of the box that was hit
+};
+
+inline AABB aabb_from_center(const glm::vec3 &center, const glm::vec3 &halfExtent) {
+  return AABB{center - halfExtent, center + halfExtent};
+}
+
+inline bool aabb_overlap(const AABB &a, const AABB &b) {
+  return a.min.x <= b.max.x && a.max.x >= b.min.x
+    && a.min.y <= b.max.y && a.max.y >= b.min.y
+    && a.min.z <= b.max.z && a.max.z >= b.min.z;
+}
+
+// slab test of origin + t*dir against box grown by pad for t up to tMax.
+// tEnter < 0 means origin starts inside, enterAxis is the axis of the face
+// entered through (-1 if none)
+inline bool aabb_slab(const glm::vec3 &origin, const glm::vec3 &dir, const glm::vec3 &pad,
+                      const AABB &box, float tMax, float &tEnter, int &enterAxis) {
+  tEnter = -std::numeric_limits<float>::infinity();
+  float tExit = tMax;
+  enterAxis = -1;
+  for (int axis = 0; axis < 3; ++axis) {
+    float lo = box.min[axis] - pad[axis];
+    float hi = box.max[axis] + pad[axis];
+    if (dir[axis] == 0.0f) {
+      if (origin[axis] < lo || origin[axis] > hi) return false;
+      continue;
+    }
+    float inv = 1.0f / dir[axis];
+    float t0 = (lo - origin[axis]) * inv;
+    float t1 = (hi - origin[axis]) * inv;
+    if (t0 > t1) std::swap(t0, t1);
+    if (t0 > tEnter) {
+      tEnter = t0;
+      enterAxis = axis;
+    }
+    tExit = std::min(tExit, t1);
+    if (tEnter > tExit) return false;
+  }
+  return tExit >= 0.0f;
+}
+
+// one box of a cast, every World's sweep runs its candidates through this so
+// they all agree on what counts as a hit. Boxes origin starts inside of are
+// skipped. Records the hit and returns true if box is entered before best,
+// which then becomes the new limit
+inline bool sweep_candidate(const glm::vec3 &origin, const glm::vec3 &dir, const glm::vec3 &pad,
+                            const AABB &box, uint32_t id, float &best, BVHHit &hit) {
+  float tEnter;
+  int axis;
+  if (!aabb_slab(origin, dir, pad, box, best, tEnter, axis) || tEnter < 0.0f || axis < 0)
+    return false;
+  best = tEnter;
+  hit.t = tEnter;
+  hit.id = id;
+  hit.normal = glm::vec3(0.0f);
+  hit.normal[axis] = dir[axis] > 0.0f ? -1.0f : 1.0f;
+  return true;
+}
+
+#endif
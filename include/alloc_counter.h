@@ -0,0 +1,30 @@
+#ifndef ALLOC_COUNTER_H
+#define ALLOC_COUNTER_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+
+// Replaces the global operator new/delete to count heap allocations, so a
+// run can show (or a test can check) that the tick loop doesn't allocate.
+// The replacements are ordinary definitions, include this from exactly one
+// translation unit per binary.
+
+inline std::atomic<size_t> heapAllocations(0);
+
+void* operator new(size_t size) {
+  ++heapAllocations;
+  if (void *p = std::malloc(size ? size : 1)) return p;
+  throw std::bad_alloc();
+}
+
+void operator delete(void *p) noexcept {
+  std::free(p);
+}
+
+void operator delete(void *p, size_t) noexcept {
+  std::free(p);
+}
+
+#endif
@@ -0,0 +1,71 @@
+#ifndef ASSETS_H
+#define ASSETS_H
+
+#include "embedded_assets.h" // generated by cmake/embed_assets.cmake
+
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <string>
+
+// Core assets (the shaders and the default voxel map) are compiled into the
+// game, so startup reads no files and doesn't care about the working
+// directory. For development, GAME_ENGINE_ASSET_DIR can point at a directory
+// (usually include/) whose copies are used instead, so shaders can be edited
+// without rebuilding. Either way #include "name" is resolved against the
+// same directory the way the build step does it.
+
+const char *const assetDirVariable = "GAME_ENGINE_ASSET_DIR";
+
+namespace assets_detail {
+
+inline bool read_file(const std::filesystem::path &path, std::string &text) {
+  std::ifstream file(path, std::ios::binary);
+  if (!file) return false;
+  text.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+  return true;
+}
+
+// pastes every #include "name" in text with name read from dir
+inline bool resolve_includes(const std::filesystem::path &dir, std::string &text, int depth) {
+  if (depth > 16) return false;
+  const char directive[] = "#include";
+  for (size_t at = text.find(directive); at != std::string::npos; at = text.find(directive, at)) {
+    size_t open = text.find_first_not_of(" \t", at + sizeof(directive) - 1);
+    if (open == std::string::npos || open == at + sizeof(directive) - 1 || text[open] != '"') {
+      at += sizeof(directive) - 1;
+      continue;
+    }
+    size_t close = text.find('"', open + 1);
+    if (close == std::string::npos) return false;
+    std::string included;
+    if (!read_file(dir / text.substr(open + 1, close - open - 1), included)
+        || !resolve_includes(dir, included, depth + 1))
+      return false;
+    text.replace(at, close + 1 - at, included);
+    at += included.size();
+  }
+  return true;
+}
+
+}
+
+// the asset called name, from the override directory if one is set and has
+// it, otherwise the embedded copy. False if neither does
+inline bool load_asset(const char *name, std::string &text) {
+  if (const char *dir = std::getenv(assetDirVariable)) {
+    if (assets_detail::read_file(std::filesystem::path(dir) / name, text))
+      return assets_detail::resolve_includes(dir, text, 0);
+  }
+  for (const EmbeddedAsset &asset : embeddedAssets) {
+    if (std::strcmp(asset.name, name) == 0) {
+      text.assign(asset.data, asset.size);
+      return true;
+    }
+  }
+  return false;
+}
+
+#endif
@@ -0,0 +1,202 @@
+#ifndef BVH_H
+#define BVH_H
+
+#include "aabb.h"
+#include "glm/glm.hpp"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Nodes are stored depth first, so the left child of an inner node is always
+// the node right after it and only the right child needs an index.
+struct BVHNode {
+  AABB bounds;
+  uint32_t offset; // leaf: first primitive, inner: index of right child
+  uint32_t count;  // primitives in a leaf, 0 for inner nodes
+};
+
+// Read-only traversal over a BVH's arrays wherever they live, in a BVH or
+// straight out of a mapped file.
+class BVHView {
+public:
+  // traversal keeps a fixed stack of this many nodes, which holds any tree
+  // whose inner nodes are at most stackSize - 2 deep
+  static const uint32_t stackSize = 64;
+
+  const BVHNode *nodes = nullptr;
+  uint32_t nodeCount = 0;
+  const AABB *boxes = nullptr;    // primitives in leaf order
+  const uint32_t *ids = nullptr;  // original index of each primitive in leaf order
+
+  bool empty() const { return !nodeCount; }
+
+  // calls visit(id, box) for every primitive overlapping box
+  template <typename Visit>
+  void overlap(const AABB &box, Visit &&visit) const {
+    if (!nodeCount) return;
+    uint32_t stack[stackSize];
+    uint32_t top = 0;
+    stack[top++] = 0;
+    while (top) {
+      const BVHNode &node = nodes[stack[--top]];
+      if (!aabb_overlap(node.bounds, box)) continue;
+      if (node.count) {
+        for (uint32_t i = node.offset; i < node.offset + node.count; ++i)
+          if (aabb_overlap(boxes[i], box))
+            visit(ids[i], boxes[i]);
+      } else {
+        stack[top++] = node.offset;
+        stack[top++] = &node - nodes + 1;
+      }
+    }
+  }
+
+  // overlap() into fixed buffers, returns how many primitives overlap in
+  // total which can be more than capacity
+  size_t overlap(const AABB &box, uint32_t *hitIds, AABB *hitBoxes, size_t capacity) const {
+    size_t count = 0;
+    overlap(box, [&](uint32_t id, const AABB &primitive) {
+      if (count < capacity) {
+        hitIds[count] = id;
+        hitBoxes[count] = primitive;
+      }
+      ++count;
+    });
+    return count;
+  }
+
+  // first hit along origin + t*dir for t in [0, tMax]
+  bool raycast(const glm::vec3 &origin, const glm::vec3 &dir, float tMax, BVHHit &hit) const {
+    return cast(origin, dir, glm::vec3(0.0f), tMax, hit);
+  }
+
+  // first box entered while moving box by t*delta for t in [0, 1]. Boxes that
+  // already overlap at t = 0 are skipped, use overlap() for those.
+  bool sweep(const AABB &box, const glm::vec3 &delta, BVHHit &hit) const {
+    glm::vec3 center = (box.min + box.max) * 0.5f;
+    glm::vec3 halfExtent = (box.max - box.min) * 0.5f;
+    return cast(center, delta, halfExtent, 1.0f, hit);
+  }
+
+private:
+  bool cast(const glm::vec3 &origin, const glm::vec3 &dir, const glm::vec3 &pad,
+            float tMax, BVHHit &hit) const {
+    if (!nodeCount) return false;
+    bool found = false;
+    float best = tMax;
+    uint32_t stack[stackSize];
+    uint32_t top = 0;
+    stack[top++] = 0;
+    while (top) {
+      const BVHNode &node = nodes[stack[--top]];
+      float tEnter;
+      int axis;
+      if (!aabb_slab(origin, dir, pad, node.bounds, best, tEnter, axis)) continue;
+      if (node.count) {
+        for (uint32_t i = node.offset; i < node.offset + node.count; ++i)
+          found = sweep_candidate(origin, dir, pad, boxes[i], ids[i], best, hit) || found;
+      } else {
+        stack[top++] = node.offset;
+        stack[top++] = &node - nodes + 1;
+      }
+    }
+    return found;
+  }
+};
+
+// Static bounding volume hierarchy, built once over a set of boxes that never
+// move. Primitives are copied into leaf order so a leaf is one contiguous run.
+class BVH {
+public:
+  static const uint32_t maxLeafSize = 4;
+
+  BVH() = default;
+
+  explicit BVH(const std::vector<AABB> &primitives) {
+    if (primitives.empty()) return;
+    std::vector<uint32_t> order(primitives.size());
+    std::vector<glm::vec3> centers(primitives.size());
+    for (uint32_t i = 0; i < primitives.size(); ++i) {
+      order[i] = i;
+      centers[i] = (primitives[i].min + primitives[i].max) * 0.5f;
+    }
+    nodes.reserve(2 * primitives.size() / maxLeafSize + 1);
+    build(primitives, centers, order, 0, order.size());
+
+    boxes.resize(order.size());
+    for (size_t i = 0; i < order.size(); ++i)
+      boxes[i] = primitives[order[i]];
+    ids = std::move(order);
+  }
+
+  bool empty() const { return nodes.empty(); }
+
+  BVHView view() const {
+    return BVHView{nodes.data(), static_cast<uint32_t>(nodes.size()), boxes.data(), ids.data()};
+  }
+
+  const std::vector<BVHNode> &node_array() const { return nodes; }
+  const std::vector<AABB> &leaf_boxes() const { return boxes; }
+  const std::vector<uint32_t> &leaf_ids() const { return ids; }
+
+  // calls visit(id, box) for every primitive overlapping box
+  template <typename Visit>
+  void overlap(const AABB &box, Visit &&visit) const {
+    view().overlap(box, visit);
+  }
+
+  // first hit along origin + t*dir for t in [0, tMax]
+  bool raycast(const glm::vec3 &origin, const glm::vec3 &dir, float tMax, BVHHit &hit) const {
+    return view().raycast(origin, dir, tMax, hit);
+  }
+
+  // first box entered while moving box by t*delta for t in [0, 1]. Boxes that
+  // already overlap at t = 0 are skipped, use overlap() for those.
+  bool sweep(const AABB &box, const glm::vec3 &delta, BVHHit &hit) const {
+    return view().sweep(box, delta, hit);
+  }
+
+private:
+  std::vector<BVHNode> nodes;
+  std::vector<AABB> boxes;   // primitives in leaf order
+  std::vector<uint32_t> ids; // original index of each primitive in leaf order
+
+  uint32_t build(const std::vector<AABB> &primitives, const std::vector<glm::vec3> &centers,
+                 std::vector<uint32_t> &order, size_t begin, size_t end) {
+    uint32_t index = nodes.size();
+    nodes.push_back(BVHNode());
+
+    AABB bounds = primitives[order[begin]];
+    AABB centerBounds{centers[order[begin]], centers[order[begin]]};
+    for (size_t i = begin + 1; i < end; ++i) {
+      bounds.min = glm::min(bounds.min, primitives[order[i]].min);
+      bounds.max = glm::max(bounds.max, primitives[order[i]].max);
+      centerBounds.min = glm::min(centerBounds.min, centers[order[i]]);
+      centerBounds.max = glm::max(centerBounds.max, centers[order[i]]);
+    }
+    nodes[index].bounds = bounds;
+
+    if (end - begin <= maxLeafSize) {
+      nodes[index].offset = begin;
+      nodes[index].count = end - begin;
+      return index;
+    }
+
+    // median split along the widest axis of the centers
+    glm::vec3 extent = centerBounds.max - centerBounds.min;
+    int axis = extent.x > extent.y ? (extent.x > extent.z ? 0 : 2) : (extent.y > extent.z ? 1 : 2);
+    size_t mid = begin + (end - begin) / 2;
+    std::nth_element(order.begin() + begin, order.begin() + mid, order.begin() + end,
+                     [&](uint32_t a, uint32_t b) { return centers[a][axis] < centers[b][axis]; });
+
+    build(primitives, centers, order, begin, mid);
+    uint32_t right = build(primitives, centers, order, mid, end);
+    nodes[index].offset = right;
+    nodes[index].count = 0;
+    return index;
+  }
+};
+
+#endif
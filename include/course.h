@@ -0,0 +1,279 @@
+#ifndef COURSE_H
+#define COURSE_H
+
+#include "aabb.h"
+#include "bvh.h"
+#include "world.h"
+#include "glm/glm.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+// Everything that shapes a generated course besides the seed.
+struct CourseParams {
+  float maxC = 300.0f;  // total arc length of the course
+  float dc = 8.0f;      // arc length between the first two platforms
+  float dcInc = 1.0f;   // how much dc grows with every platform
+  float dcMax = 25.0f;  // dc stops growing here, only reached by long or endless courses
+  float rMin = 5.0f;    // radius of each arc is uniform in [rMin, rMax)
+  float rMax = 20.0f;
+  float thetaLengthMin = M_PI/2; // angle each arc turns is uniform in [min, max)
+  float thetaLengthMax = 2*M_PI;
+  glm::vec3 platformScale = glm::vec3(0.4f, 0.1f, 0.4f);
+};
+
+// Every float of CourseParams, in the one order demos and course files store
+// them and comparisons check them. A new field goes here too, the
+// static_assert below catches one that doesn't.
+#define COURSE_PARAMS_FIELDS(X) \
+  X(maxC) X(dc) X(dcInc) X(dcMax) X(rMin) X(rMax) X(thetaLengthMin) X(thetaLengthMax) \
+  X(platformScale.x) X(platformScale.y) X(platformScale.z)
+
+#define COURSE_PARAMS_COUNT(field) + 1
+const size_t courseParamCount = 0 COURSE_PARAMS_FIELDS(COURSE_PARAMS_COUNT);
+#undef COURSE_PARAMS_COUNT
+static_assert(sizeof(CourseParams) == courseParamCount * sizeof(float),
+              "CourseParams has a field COURSE_PARAMS_FIELDS doesn't list");
+
+// calls visit(field) on every field in COURSE_PARAMS_FIELDS order, params
+// can be const
+template <typename Params, typename Visit>
+void for_each_course_param(Params &params, Visit &&visit) {
+#define COURSE_PARAMS_VISIT(field) visit(params.field);
+  COURSE_PARAMS_FIELDS(COURSE_PARAMS_VISIT)
+#undef COURSE_PARAMS_VISIT
+}
+
+// bit for bit, which is what it takes to generate the same course
+inline bool same_course_params(const CourseParams &a, const CourseParams &b) {
+  float fa[courseParamCount], fb[courseParamCount];
+  size_t na = 0, nb = 0;
+  for_each_course_param(a, [&](float f) { fa[na++] = f; });
+  for_each_course_param(b, [&](float f) { fb[nb++] = f; });
+  return std::memcmp(fa, fb, sizeof(fa)) == 0;
+}
+
+// SplitMix64. Unlike std::mt19937 + std::uniform_real_distribution the
+// floats it produces are the same on every standard library.
+class CourseRng {
+public:
+  explicit CourseRng(uint64_t seed) : state(seed) {}
+
+  uint64_t next() {
+    uint64_t z = (state += 0x9e3779b97f4a7c15ull);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+    return z ^ (z >> 31);
+  }
+
+  // uniform in [lo, hi), from the top 24 bits so every value is exact
+  float uniform(float lo, float hi) {
+    float u = static_cast<float>(next() >> 40) * (1.0f / 16777216.0f);
+    return lo + (hi - lo) * u;
+  }
+
+private:
+  uint64_t state;
+};
+
+// sin/cos from plain arithmetic so the generator doesn't depend on how a
+// given libm rounds, good to ~1e-15 which is far below float precision
+inline void course_sincos(float angle, float &s, float &c) {
+  const double twoPi = 6.283185307179586;
+  const double halfPi = 1.5707963267948966;
+  double x = angle - twoPi * std::floor(angle / twoPi + 0.5); // [-pi, pi]
+  // reduce to [-pi/4, pi/4] and remember which quadrant we came from
+  double q = std::floor(x / halfPi + 0.5);
+  double r = x - q * halfPi;
+  double r2 = r * r;
+  double sr = r * (1.0 + r2 * (-1.0/6 + r2 * (1.0/120 + r2 * (-1.0/5040 + r2 * (1.0/362880
+    + r2 * (-1.0/39916800 + r2 * (1.0/6227020800)))))));
+  double cr = 1.0 + r2 * (-0.5 + r2 * (1.0/24 + r2 * (-1.0/720 + r2 * (1.0/40320
+    + r2 * (-1.0/3628800 + r2 * (1.0/479001600 + r2 * (-1.0/87178291200)))))));
+  switch ((static_cast<int>(q) % 4 + 4) % 4) {
+    case 0: s = sr; c = cr; break;
+    case 1: s = cr; c = -sr; break;
+    case 2: s = -sr; c = -cr; break;
+    default: s = -cr; c = sr; break;
+  }
+}
+
+// Spiral of descending platforms, each arc turns the other way around a new
+// pivot. Hands out one platform at a time so callers that only need stats
+// don't have to keep the whole course around. An endless generator ignores
+// maxC and never runs out.
+class CourseGenerator {
+public:
+  int flips = 0; // arcs finished, i.e. times the spiral changed direction
+
+  CourseGenerator(uint64_t seed, const CourseParams &params, bool endless = false)
+    : params(params), rng(seed), endless(endless), dc(params.dc), lastDc(params.dc - params.dcInc) {
+    r = rng.uniform(params.rMin, params.rMax);
+    dtheta = dc/(2.0f*r);
+  }
+
+  // platform the player spawns above, in platform units
+  glm::vec3 spawn_platform() const {
+    float s, c;
+    course_sincos(theta + rot*dtheta, s, c);
+    return pivot + glm::vec3(r*c, y, r*s);
+  }
+
+  // next platform in platform units, false once the course is maxC long
+  bool next(glm::vec3 &platform) {
+    while (true) {
+      if (!inArc) {
+        if (!endless && sumC + dc >= params.maxC) return false;
+        thetaLength = rng.uniform(params.thetaLengthMin, params.thetaLengthMax);
+        startTheta = theta;
+        theta += rot*dtheta;
+        inArc = true;
+      }
+      if (std::abs(startTheta - theta) <= thetaLength && (endless || sumC + dc <= params.maxC)) {
+        float s, c;
+        course_sincos(theta, s, c);
+        pos = pivot + glm::vec3(r*c, 0, r*s);
+        y -= 2.0f;
+        platform = pos + glm::vec3(0.0f, y, 0.0f);
+        sumC += dc;
+        lastDc = dc;
+        dc = std::min(dc + params.dcInc, params.dcMax);
+        dtheta = dc/(2.0f*r);
+        theta += rot*dtheta;
+        return true;
+      }
+
+      // arc is done, continue on a new circle tangent to this one
+      r = rng.uniform(params.rMin, params.rMax);
+
+      pivot = pos + r*glm::normalize(pos - pivot);
+      theta -= rot*(lastDc/(2.0f*r));
+      theta = theta < M_PI ? theta + M_PI : theta - M_PI;
+      rot = -rot;
+      ++flips;
+      inArc = false;
+    }
+  }
+
+  // y of the last platform handed out, in platform units
+  float last_y() const { return y; }
+
+  // moves the origin by offset so an endless course never drifts out to
+  // where floats get coarse
+  void rebase(const glm::vec3 &offset) {
+    // pivot and pos stay in the y = 0 plane, the height lives in y
+    glm::vec3 flat = glm::vec3(offset.x, 0.0f, offset.z);
+    pivot -= flat;
+    pos -= flat;
+    y -= offset.y;
+  }
+
+private:
+  CourseParams params;
+  CourseRng rng;
+  bool endless;
+
+  float sumC = 0.0f;
+  float dc;
+  float lastDc; // spacing before the last platform, dc may have been capped since
+  float r;
+  float theta = 0.0f;
+  float dtheta;
+  float startTheta = 0.0f;
+  float thetaLength = 0.0f;
+  bool inArc = false;
+  glm::vec3 pivot = glm::vec3(0.0f, 0.0f, 0.0f);
+  glm::vec3 pos = glm::vec3(0.0f, 0.0f, 0.0f);
+  float y = 1.0f;
+  int rot = 1;
+};
+
+// A generated course. Platform positions are in platform units, multiply by
+// platformScale to get world space.
+struct Course : World {
+  uint64_t seed;
+  CourseParams params;
+  glm::vec3 platformScale;
+  std::vector<glm::vec3> platformPositions;
+  glm::vec3 spawn;
+  float lowestPlatform;
+  BVH bvh; // over the scaled platform bounds, built once after generation
+
+  AABB platform_bounds(size_t i) const {
+    return aabb_from_center(platformPositions[i] * platformScale, platformScale/2.0f);
+  }
+
+  glm::vec3 spawn_point() const override { return spawn; }
+  float respawn_height() const override { return lowestPlatform - 0.5f; }
+  // the last platform is the lowest one
+  bool is_finish(uint32_t platform) const override { return platform + 1 == platformPositions.size(); }
+
+  size_t overlap(const AABB &box, uint32_t *ids, AABB *boxes, size_t capacity) const override {
+    return bvh.view().overlap(box, ids, boxes, capacity);
+  }
+
+  bool sweep(const AABB &box, const glm::vec3 &delta, BVHHit &hit) const override {
+    return bvh.sweep(box, delta, hit);
+  }
+};
+
+// the same seed and params give the same course on every run and compiler
+inline Course generate_course(uint64_t seed, const CourseParams &params, const glm::vec3 &playerSize) {
+  Course course;
+  course.seed = seed;
+  course.params = params;
+  course.platformScale = params.platformScale;
+
+  CourseGenerator generator(seed, params);
+  course.spawn = generator.spawn_platform()*params.platformScale + glm::vec3(0.0f, playerSize.y + 1.0f, 0.0f);
+  glm::vec3 platform;
+  while (generator.next(platform))
+    course.platformPositions.push_back(platform);
+  course.lowestPlatform = generator.last_y()*params.platformScale.y;
+
+  std::vector<AABB> platformBounds;
+  platformBounds.reserve(course.platformPositions.size());
+  for (size_t i = 0; i < course.platformPositions.size(); ++i)
+    platformBounds.push_back(course.platform_bounds(i));
+  course.bvh = BVH(platformBounds);
+  return course;
+}
+
+// Summary of a course for picking seeds, in world units. Computed straight
+// off the generator so nothing is allocated per platform.
+struct CourseStats {
+  uint32_t platforms = 0;
+  int flips = 0;       // direction changes between the first and last platform
+  float length = 0.0f; // path through the platform centers
+  float drop = 0.0f;   // height from the first platform to the last
+  AABB bounds{glm::vec3(0.0f), glm::vec3(0.0f)}; // of the platform centers
+};
+
+inline CourseStats course_stats(uint64_t seed, const CourseParams &params) {
+  CourseStats stats;
+  CourseGenerator generator(seed, params);
+  glm::vec3 platform, prev, first;
+  while (generator.next(platform)) {
+    platform *= params.platformScale;
+    if (stats.platforms == 0) {
+      first = platform;
+      stats.bounds = AABB{platform, platform};
+    } else {
+      stats.length += glm::length(platform - prev);
+      stats.bounds.min = glm::min(stats.bounds.min, platform);
+      stats.bounds.max = glm::max(stats.bounds.max, platform);
+    }
+    // flips counted after the last platform don't change the course
+    stats.flips = generator.flips;
+    prev = platform;
+    ++stats.platforms;
+  }
+  if (stats.platforms) stats.drop = first.y - prev.y;
+  return stats;
+}
+
+#endif
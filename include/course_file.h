@@ -0,0 +1,238 @@
+#ifndef COURSE_FILE_H
+#define COURSE_FILE_H
+
+#include "aabb.h"
+#include "bvh.h"
+#include "course.h"
+#include "world.h"
+#include "glm/glm.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <type_traits>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Binary course laid out to be mmap()ed and used in place: a fixed header
+// followed by arrays in exactly the in-memory layout the game uses, each
+// starting on an 8 byte boundary.
+//
+// header:     CourseFileHeader
+// positions:  glm::vec3[platformCount], platform units, course order
+// boxes:      AABB[platformCount], world space, BVH leaf order
+// ids:        uint32_t[platformCount], course index of each box
+// nodes:      BVHNode[nodeCount]
+//
+// Files are written in the host's byte order and rejected by a host with a
+// different one. Processes mapping the same file share one page cache copy.
+
+const uint32_t courseFileVersion = 1;
+const uint32_t courseFileByteOrder = 0x01020304;
+
+struct CourseFileHeader {
+  char magic[4];       // "GECS"
+  uint32_t version;
+  uint32_t byteOrder;  // courseFileByteOrder as written by the host
+  uint32_t platformCount;
+  uint64_t seed;
+  float params[courseParamCount]; // in COURSE_PARAMS_FIELDS order
+  float spawn[3];
+  float lowestPlatform;
+  uint32_t nodeCount;
+  uint64_t positionsOffset;
+  uint64_t boxesOffset;
+  uint64_t idsOffset;
+  uint64_t nodesOffset;
+  uint64_t fileSize;
+};
+
+// the arrays are used in place, so their layout is the file format
+static_assert(sizeof(glm::vec3) == 12, "glm::vec3 must be 3 packed floats");
+static_assert(sizeof(AABB) == 24, "AABB must be 6 packed floats");
+static_assert(sizeof(BVHNode) == 32, "BVHNode must be an AABB and 2 uint32s");
+static_assert(sizeof(CourseFileHeader) == 128, "CourseFileHeader has padding");
+static_assert(std::is_trivially_copyable<BVHNode>::value, "BVHNode must be trivially copyable");
+
+namespace course_file_detail {
+
+inline uint64_t align8(uint64_t offset) {
+  return (offset + 7) & ~uint64_t(7);
+}
+
+inline void params_to_floats(const CourseParams &p, float *out) {
+  for_each_course_param(p, [&](float f) { *out++ = f; });
+}
+
+inline CourseParams params_from_floats(const float *in) {
+  CourseParams p;
+  for_each_course_param(p, [&](float &f) { f = *in++; });
+  return p;
+}
+
+}
+
+inline bool save_course(const Course &course, const std::filesystem::path &path) {
+  using namespace course_file_detail;
+  const BVH &bvh = course.bvh;
+  CourseFileHeader header{};
+  std::memcpy(header.magic, "GECS", 4);
+  header.version = courseFileVersion;
+  header.byteOrder = courseFileByteOrder;
+  header.platformCount = course.platformPositions.size();
+  header.seed = course.seed;
+  params_to_floats(course.params, header.params);
+  for (int i = 0; i < 3; ++i) header.spawn[i] = course.spawn[i];
+  header.lowestPlatform = course.lowestPlatform;
+  header.nodeCount = bvh.node_array().size();
+  header.positionsOffset = align8(sizeof(CourseFileHeader));
+  header.boxesOffset = align8(header.positionsOffset + header.platformCount * sizeof(glm::vec3));
+  header.idsOffset = align8(header.boxesOffset + header.platformCount * sizeof(AABB));
+  header.nodesOffset = align8(header.idsOffset + header.platformCount * sizeof(uint32_t));
+  header.fileSize = header.nodesOffset + header.nodeCount * sizeof(BVHNode);
+
+  std::ofstream file(path, std::ios::binary);
+  auto write_at = [&](uint64_t offset, const void *data, size_t size) {
+    // zero padding up to offset
+    static const char zeros[8] = {};
+    file.write(zeros, offset - static_cast<uint64_t>(file.tellp()));
+    file.write(static_cast<const char*>(data), size);
+  };
+  file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+  write_at(header.positionsOffset, course.platformPositions.data(), header.platformCount * sizeof(glm::vec3));
+  write_at(header.boxesOffset, bvh.leaf_boxes().data(), header.platformCount * sizeof(AABB));
+  write_at(header.idsOffset, bvh.leaf_ids().data(), header.platformCount * sizeof(uint32_t));
+  write_at(header.nodesOffset, bvh.node_array().data(), header.nodeCount * sizeof(BVHNode));
+  return static_cast<bool>(file);
+}
+
+// A course file mapped read-only and used where it lies, nothing is parsed
+// or copied. Opening checks the header and reads all of the BVH nodes and
+// ids once, so a corrupt or hostile file can't send collision queries out of
+// bounds. That's linear in the platform count, a few ms per million. The
+// positions and boxes are only read in as the course is touched.
+class MappedCourse : public World {
+public:
+  MappedCourse() = default;
+  MappedCourse(const MappedCourse&) = delete;
+  MappedCourse &operator=(const MappedCourse&) = delete;
+
+  ~MappedCourse() override { close(); }
+
+  bool open(const std::filesystem::path &path) {
+    close();
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+    struct stat st;
+    if (fstat(fd, &st) == 0 && st.st_size >= static_cast<off_t>(sizeof(CourseFileHeader))) {
+      size = st.st_size;
+      void *p = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+      data = p == MAP_FAILED ? nullptr : static_cast<const uint8_t*>(p);
+    }
+    ::close(fd);
+    if (!data || !validate()) {
+      close();
+      return false;
+    }
+    return true;
+  }
+
+  void close() {
+    if (data) munmap(const_cast<uint8_t*>(data), size);
+    data = nullptr;
+    size = 0;
+    header = nullptr;
+  }
+
+  uint64_t seed() const { return header->seed; }
+  CourseParams params() const { return course_file_detail::params_from_floats(header->params); }
+  glm::vec3 platform_scale() const { return params().platformScale; }
+  size_t platform_count() const { return header->platformCount; }
+  // platform units, course order, the same as Course::platformPositions
+  const glm::vec3 *platform_positions() const { return at<glm::vec3>(header->positionsOffset); }
+
+  glm::vec3 spawn_point() const override { return glm::vec3(header->spawn[0], header->spawn[1], header->spawn[2]); }
+  float respawn_height() const override { return header->lowestPlatform - 0.5f; }
+  bool is_finish(uint32_t platform) const override { return platform + 1 == header->platformCount; }
+
+  size_t overlap(const AABB &box, uint32_t *ids, AABB *boxes, size_t capacity) const override {
+    return bvh.overlap(box, ids, boxes, capacity);
+  }
+
+  bool sweep(const AABB &box, const glm::vec3 &delta, BVHHit &hit) const override {
+    return bvh.sweep(box, delta, hit);
+  }
+
+private:
+  const uint8_t *data = nullptr;
+  size_t size = 0;
+  const CourseFileHeader *header = nullptr;
+  BVHView bvh;
+
+  template <typename T>
+  const T *at(uint64_t offset) const {
+    return reinterpret_cast<const T*>(data + offset);
+  }
+
+  // checks the header, that every array lies inside the file and that the
+  // BVH is a tree traversal can walk safely, positions and boxes are only
+  // floats so anything goes there
+  bool validate() {
+    header = at<CourseFileHeader>(0);
+    if (std::memcmp(header->magic, "GECS", 4) != 0 || header->version != courseFileVersion
+        || header->byteOrder != courseFileByteOrder || header->fileSize != size)
+      return false;
+    uint64_t n = header->platformCount;
+    auto inside = [&](uint64_t offset, uint64_t bytes) {
+      return offset % 8 == 0 && offset <= size && bytes <= size - offset;
+    };
+    if (!inside(header->positionsOffset, n * sizeof(glm::vec3)) || !inside(header->boxesOffset, n * sizeof(AABB))
+        || !inside(header->idsOffset, n * sizeof(uint32_t))
+        || !inside(header->nodesOffset, header->nodeCount * uint64_t(sizeof(BVHNode))))
+      return false;
+    const uint32_t *ids = at<uint32_t>(header->idsOffset);
+    for (uint64_t i = 0; i < n; ++i)
+      if (ids[i] >= n) return false;
+    bvh = BVHView{at<BVHNode>(header->nodesOffset), header->nodeCount,
+                  at<AABB>(header->boxesOffset), ids};
+    return valid_tree();
+  }
+
+  // save_course() writes nodes depth first, so node i's subtree is a
+  // contiguous range [i, end): the left child is i + 1 and the right child
+  // starts the second half. Checking every node against its range makes
+  // sure each is reached exactly once, leaves stay inside the boxes and
+  // the tree is shallow enough for BVHView's stack
+  bool valid_tree() const {
+    if (!bvh.nodeCount) return true;
+    struct Range {
+      uint32_t node, end, depth;
+    };
+    Range stack[BVHView::stackSize];
+    uint32_t top = 0;
+    stack[top++] = Range{0, bvh.nodeCount, 0};
+    while (top) {
+      Range range = stack[--top];
+      const BVHNode &node = bvh.nodes[range.node];
+      if (node.count) {
+        if (range.end != range.node + 1
+            || uint64_t(node.offset) + node.count > header->platformCount)
+          return false;
+        continue;
+      }
+      uint32_t right = node.offset;
+      if (range.depth + 2 > BVHView::stackSize || right <= range.node + 1 || right >= range.end)
+        return false;
+      stack[top++] = Range{right, range.end, range.depth + 1};
+      stack[top++] = Range{range.node + 1, right, range.depth + 1};
+    }
+    return true;
+  }
+};
+
+#endif
@@ -0,0 +1,281 @@
+#ifndef DEMO_H
+#define DEMO_H
+
+#include "course.h"
+#include "simulation.h"
+#include "glm/glm.hpp"
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <vector>
+
+// Binary demo of one run: what's needed to rebuild the course and the
+// physics, then the input of every tick from spawn on.
+//
+// header:  "GEDM", version, seed, CourseParams, PhysicsParams, tick count
+//          (the params as floats in COURSE_PARAMS_FIELDS and
+//          PHYSICS_PARAMS_FIELDS order)
+// ticks:   records of [head byte][run varint][yaw varint][pitch varint]
+//          head bits 0-4 are the buttons, bit 5/6 say a yaw/pitch delta
+//          follows, bit 7 says a run length follows. A record covers
+//          run + 2 ticks (1 without bit 7) that all repeat the same buttons
+//          and angle deltas. Deltas are zigzag varints in angle units.
+//
+// Everything is little endian. Angles are quantized to 1/angleUnits of a
+// degree before they reach the simulation, live or replayed, so a replay
+// sees exactly the floats the run saw.
+
+// Only the current version loads, demos from any other were recorded with
+// a different generator or physics and wouldn't replay the same.
+const uint32_t demoVersion = 4;
+const float angleUnits = 256.0f;
+
+inline int32_t quantize_angle(float degrees) {
+  return static_cast<int32_t>(std::lround(degrees * angleUnits));
+}
+
+inline void quantize_angles(TickInput &input) {
+  input.yaw = quantize_angle(input.yaw) / angleUnits;
+  input.pitch = quantize_angle(input.pitch) / angleUnits;
+}
+
+namespace demo_detail {
+
+inline uint8_t buttons_of(const TickInput &input) {
+  return input.forward | input.back << 1 | input.left << 2 | input.right << 3 | input.jump << 4;
+}
+
+inline void put_u32(std::vector<uint8_t> &out, uint32_t v) {
+  for (int i = 0; i < 4; ++i) out.push_back(v >> (8 * i));
+}
+
+inline void put_u64(std::vector<uint8_t> &out, uint64_t v) {
+  for (int i = 0; i < 8; ++i) out.push_back(v >> (8 * i));
+}
+
+inline void put_float(std::vector<uint8_t> &out, float f) {
+  uint32_t v;
+  std::memcpy(&v, &f, sizeof(v));
+  put_u32(out, v);
+}
+
+inline void put_varint(std::vector<uint8_t> &out, uint64_t v) {
+  while (v >= 0x80) {
+    out.push_back(static_cast<uint8_t>(v) | 0x80);
+    v >>= 7;
+  }
+  out.push_back(static_cast<uint8_t>(v));
+}
+
+inline uint32_t zigzag(int32_t v) {
+  return (static_cast<uint32_t>(v) << 1) ^ static_cast<uint32_t>(v >> 31);
+}
+
+inline int32_t unzigzag(uint32_t v) {
+  return static_cast<int32_t>(v >> 1) ^ -static_cast<int32_t>(v & 1);
+}
+
+// bounds checked reads over a loaded file, any overrun sets ok to false
+struct Cursor {
+  const uint8_t *p;
+  const uint8_t *end;
+  bool ok = true;
+
+  uint64_t bytes(int n) {
+    if (end - p < n) {
+      ok = false;
+      return 0;
+    }
+    uint64_t v = 0;
+    for (int i = 0; i < n; ++i) v |= static_cast<uint64_t>(*p++) << (8 * i);
+    return v;
+  }
+
+  float f32() {
+    uint32_t v = bytes(4);
+    float f;
+    std::memcpy(&f, &v, sizeof(f));
+    return f;
+  }
+
+  uint64_t varint() {
+    uint64_t v = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+      if (p == end) break;
+      uint8_t b = *p++;
+      v |= static_cast<uint64_t>(b & 0x7f) << shift;
+      if (!(b & 0x80)) return v;
+    }
+    ok = false;
+    return 0;
+  }
+};
+
+}
+
+struct DemoInfo {
+  uint64_t seed = 0;
+  CourseParams course;
+  PhysicsParams physics;
+  uint64_t ticks = 0;
+};
+
+// Records one run. Inputs must already be quantize_angles()'d, which is
+// what makes the replay exact.
+class DemoWriter {
+public:
+  DemoInfo info;
+
+  DemoWriter(uint64_t seed, const CourseParams &course, const PhysicsParams &physics) {
+    info.seed = seed;
+    info.course = course;
+    info.physics = physics;
+  }
+
+  // drops everything recorded so far, for when the run restarts
+  void reset() {
+    records.clear();
+    info.ticks = 0;
+    lastYaw = lastPitch = 0;
+    haveRecord = false;
+  }
+
+  void record(const TickInput &input) {
+    using namespace demo_detail;
+    int32_t yaw = quantize_angle(input.yaw);
+    int32_t pitch = quantize_angle(input.pitch);
+    Record next{buttons_of(input), yaw - lastYaw, pitch - lastPitch, 1};
+    lastYaw = yaw;
+    lastPitch = pitch;
+    ++info.ticks;
+    if (haveRecord && next.buttons == current.buttons
+        && next.dyaw == current.dyaw && next.dpitch == current.dpitch) {
+      ++current.run;
+      return;
+    }
+    if (haveRecord) flush();
+    current = next;
+    haveRecord = true;
+  }
+
+  bool save(const std::filesystem::path &path) {
+    using namespace demo_detail;
+    if (haveRecord) {
+      flush();
+      haveRecord = false;
+    }
+    std::vector<uint8_t> out;
+    out.reserve(24 + (courseParamCount + physicsParamCount) * sizeof(float) + records.size());
+    for (char c : {'G', 'E', 'D', 'M'}) out.push_back(c);
+    put_u32(out, demoVersion);
+    put_u64(out, info.seed);
+    for_each_course_param(info.course, [&](float f) { put_float(out, f); });
+    for_each_physics_param(info.physics, [&](float f) { put_float(out, f); });
+    put_u64(out, info.ticks);
+    out.insert(out.end(), records.begin(), records.end());
+
+    std::ofstream file(path, std::ios::binary);
+    file.write(reinterpret_cast<const char*>(out.data()), out.size());
+    return static_cast<bool>(file);
+  }
+
+private:
+  struct Record {
+    uint8_t buttons;
+    int32_t dyaw;
+    int32_t dpitch;
+    uint64_t run;
+  };
+
+  std::vector<uint8_t> records;
+  Record current;
+  bool haveRecord = false;
+  int32_t lastYaw = 0;
+  int32_t lastPitch = 0;
+
+  void flush() {
+    using namespace demo_detail;
+    uint8_t head = current.buttons;
+    if (current.dyaw) head |= 1 << 5;
+    if (current.dpitch) head |= 1 << 6;
+    if (current.run > 1) head |= 1 << 7;
+    records.push_back(head);
+    if (current.run > 1) put_varint(records, current.run - 2);
+    if (current.dyaw) put_varint(records, zigzag(current.dyaw));
+    if (current.dpitch) put_varint(records, zigzag(current.dpitch));
+  }
+};
+
+// Plays a demo back one tick at a time.
+class DemoReader {
+public:
+  DemoInfo info;
+
+  bool load(const std::filesystem::path &path) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file) return false;
+    data.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    return parse();
+  }
+
+  bool load(std::vector<uint8_t> bytes) {
+    data = std::move(bytes);
+    return parse();
+  }
+
+  // false once every tick has been read or the data turns out to be broken
+  bool next(TickInput &input) {
+    using namespace demo_detail;
+    if (read == info.ticks) return false;
+    if (!run) {
+      uint8_t head = cursor.bytes(1);
+      run = head & 1 << 7 ? cursor.varint() + 2 : 1;
+      buttons = head & 0x1f;
+      dyaw = head & 1 << 5 ? unzigzag(cursor.varint()) : 0;
+      dpitch = head & 1 << 6 ? unzigzag(cursor.varint()) : 0;
+      if (!cursor.ok) return false;
+    }
+    --run;
+    ++read;
+    yaw += dyaw;
+    pitch += dpitch;
+    input.forward = buttons & 1;
+    input.back = buttons & 1 << 1;
+    input.left = buttons & 1 << 2;
+    input.right = buttons & 1 << 3;
+    input.jump = buttons & 1 << 4;
+    input.yaw = yaw / angleUnits;
+    input.pitch = pitch / angleUnits;
+    return true;
+  }
+
+private:
+  std::vector<uint8_t> data;
+  demo_detail::Cursor cursor{nullptr, nullptr};
+  uint64_t read = 0;
+  uint64_t run = 0;
+  uint8_t buttons = 0;
+  int32_t dyaw = 0, dpitch = 0;
+  int32_t yaw = 0, pitch = 0;
+
+  bool parse() {
+    cursor = demo_detail::Cursor{data.data(), data.data() + data.size()};
+    read = run = 0;
+    yaw = pitch = 0;
+    if (data.size() < 4 || std::memcmp(data.data(), "GEDM", 4) != 0) return false;
+    cursor.p += 4;
+    uint32_t version = cursor.bytes(4);
+    if (version != demoVersion) return false;
+    info.seed = cursor.bytes(8);
+    for_each_course_param(info.course, [&](float &f) { f = cursor.f32(); });
+    for_each_physics_param(info.physics, [&](float &f) { f = cursor.f32(); });
+    info.ticks = cursor.bytes(8);
+    return cursor.ok;
+  }
+};
+
+#endif
@@ -0,0 +1,9 @@
+// per-frame camera and lighting, shared by every program, see
+// include/frame_uniforms.h
+layout (std140) uniform FrameData {
+  mat4 view;
+  mat4 projection;
+  vec4 viewPos;
+  vec4 lightPos;
+  vec4 lightColor;
+};
@@ -0,0 +1,48 @@
+#ifndef FRAME_UNIFORMS_H
+#define FRAME_UNIFORMS_H
+
+#include "glad/glad.h"
+#include "shader.h"
+#include "stream_buffer.h"
+#include "glm/glm.hpp"
+
+#include <cstring>
+
+// Camera and lighting shared by every program through one std140 uniform
+// block, written once per frame into the stream buffer however many
+// programs draw with it. Shaders declare it with #include "frame_data.glsl",
+// which this has to match.
+// vec3s are padded out to vec4s, std140 would align them to 16 bytes anyway.
+struct FrameData {
+  glm::mat4 view;
+  glm::mat4 projection;
+  glm::vec4 viewPos;
+  glm::vec4 lightPos;
+  glm::vec4 lightColor;
+};
+
+static_assert(sizeof(FrameData) == 176, "FrameData must match the std140 layout");
+
+const GLuint frameDataBinding = 0;
+
+class FrameUniforms {
+public:
+  // points a program's FrameData block at binding point frameDataBinding,
+  // once per program
+  void attach(Shader &shader) const {
+    shader.bindUniformBlock("FrameData", frameDataBinding);
+  }
+
+  // writes this frame's data into the stream buffer and binds that range,
+  // false if the frame's region had no room left
+  bool update(StreamBuffer &stream, const FrameData &data) const {
+    GLintptr offset;
+    void *p = stream.allocate(sizeof(FrameData), stream.uniform_alignment(), offset);
+    if (!p) return false;
+    std::memcpy(p, &data, sizeof(FrameData));
+    glBindBufferRange(GL_UNIFORM_BUFFER, frameDataBinding, stream.buffer(), offset, sizeof(FrameData));
+    return true;
+  }
+};
+
+#endif
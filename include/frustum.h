@@ -0,0 +1,283 @@
+#ifndef FRUSTUM_H
+#define FRUSTUM_H
+
+#include "aabb.h"
+#include "glm/glm.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// the six planes of a view frustum, xyz points inwards and a point p is on
+// the inside of a plane when dot(xyz, p) + w >= 0
+struct Frustum {
+  glm::vec4 planes[6];
+};
+
+// planes straight out of a projection * view matrix (Gribb & Hartmann)
+inline Frustum frustum_from_matrix(const glm::mat4 &m) {
+  glm::vec4 row[4];
+  for (int i = 0; i < 4; ++i)
+    row[i] = glm::vec4(m[0][i], m[1][i], m[2][i], m[3][i]);
+  Frustum f;
+  f.planes[0] = row[3] + row[0]; // left
+  f.planes[1] = row[3] - row[0]; // right
+  f.planes[2] = row[3] + row[1]; // bottom
+  f.planes[3] = row[3] - row[1]; // top
+  f.planes[4] = row[3] + row[2]; // near
+  f.planes[5] = row[3] - row[2]; // far
+  for (glm::vec4 &p : f.planes)
+    p /= glm::length(glm::vec3(p));
+  return f;
+}
+
+// Culls a fixed set of boxes against a frustum. Bounds are kept as separate
+// center and extent arrays (structure of arrays) so each plane test runs on
+// a whole register of boxes at once: 8 with AVX, 4 with SSE2, one at a time
+// otherwise. A box is kept unless it lies entirely behind one plane, which
+// keeps a few near the frustum's corners but never drops a visible one.
+//
+// Sets larger than parallelThreshold are split across threads. Each culls a
+// contiguous range into the same range of the output, which is compacted
+// afterwards so the result stays in box order. The calling thread takes the
+// first range and the workers, started on the first parallel cull and kept
+// for the culler's lifetime, wait on a condition variable for the rest.
+class FrustumCuller {
+public:
+  static const size_t parallelThreshold = 1 << 16;
+
+  unsigned threads = std::max(1u, std::thread::hardware_concurrency());
+
+  FrustumCuller() = default;
+  FrustumCuller(const FrustumCuller&) = delete;
+  FrustumCuller &operator=(const FrustumCuller&) = delete;
+  ~FrustumCuller() { stop_workers(); }
+
+  // replaces the set of boxes, ids handed out by cull() index into it
+  void set_boxes(const AABB *boxes, size_t count) {
+    size = count;
+    // padded to a full register, the padding is never reported
+    size_t padded = (count + lanes - 1) / lanes * lanes;
+    for (int a = 0; a < 3; ++a) {
+      center[a].assign(padded, 0.0f);
+      extent[a].assign(padded, 0.0f);
+    }
+    for (size_t i = 0; i < count; ++i) {
+      glm::vec3 c = (boxes[i].min + boxes[i].max) * 0.5f;
+      glm::vec3 e = (boxes[i].max - boxes[i].min) * 0.5f;
+      for (int a = 0; a < 3; ++a) {
+        center[a][i] = c[a];
+        extent[a][i] = e[a];
+      }
+    }
+  }
+
+  size_t box_count() const { return size; }
+
+  // fills visible with the ids of the boxes inside frustum, in order, and
+  // returns how many there are
+  size_t cull(const Frustum &frustum, std::vector<uint32_t> &visible) {
+    visible.resize(size);
+    unsigned workers = size >= parallelThreshold ? std::max(1u, threads) : 1;
+    if (workers == 1) {
+      visible.resize(cull_range(frustum, 0, size, visible.data()));
+      return visible.size();
+    }
+
+    if (pool.size() != workers - 1) {
+      stop_workers();
+      start_workers(workers - 1);
+    }
+    // ranges are whole registers so no two workers share one
+    size_t registers = (size + lanes - 1) / lanes;
+    size_t perWorker = (registers + workers - 1) / workers * lanes;
+    counts.assign(workers, 0);
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      job = Job{&frustum, visible.data(), perWorker};
+      pending = workers - 1;
+      ++generation;
+    }
+    wake.notify_all();
+    counts[0] = cull_part(job, 0);
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      done.wait(lock, [&]() { return pending == 0; });
+    }
+
+    // close the gaps between each worker's results
+    size_t total = 0;
+    for (unsigned t = 0; t < workers; ++t) {
+      size_t first = std::min(size, t * perWorker);
+      if (first != total)
+        std::memmove(visible.data() + total, visible.data() + first, counts[t] * sizeof(uint32_t));
+      total += counts[t];
+    }
+    visible.resize(total);
+    return total;
+  }
+
+private:
+#if defined(__AVX__)
+  static const size_t lanes = 8;
+#elif defined(__SSE2__)
+  static const size_t lanes = 4;
+#else
+  static const size_t lanes = 1;
+#endif
+
+  // one parallel cull, worker t takes boxes [t*perWorker, (t+1)*perWorker)
+  struct Job {
+    const Frustum *frustum;
+    uint32_t *out;
+    size_t perWorker;
+  };
+
+  size_t size = 0;
+  std::vector<float> center[3];
+  std::vector<float> extent[3];
+  std::vector<size_t> counts; // survivors of each part of the last cull
+  std::vector<std::thread> pool;
+  std::mutex mutex;
+  std::condition_variable wake; // a new job or stopping
+  std::condition_variable done; // pending reached 0
+  Job job{};
+  uint64_t generation = 0;      // bumped for every job
+  unsigned pending = 0;         // workers still on the current job
+  bool stopping = false;
+
+  size_t cull_part(const Job &part, unsigned t) const {
+    size_t first = std::min(size, t * part.perWorker);
+    size_t last = std::min(size, first + part.perWorker);
+    return cull_range(*part.frustum, first, last, part.out + first);
+  }
+
+  void start_workers(unsigned count) {
+    stopping = false;
+    for (unsigned t = 1; t <= count; ++t)
+      pool.emplace_back([this, t, seen = generation]() mutable {
+        std::unique_lock<std::mutex> lock(mutex);
+        while (true) {
+          wake.wait(lock, [&]() { return stopping || generation != seen; });
+          if (stopping) return;
+          seen = generation;
+          Job part = job;
+          lock.unlock();
+          size_t n = cull_part(part, t);
+          lock.lock();
+          counts[t] = n;
+          if (--pending == 0) done.notify_one();
+        }
+      });
+  }
+
+  void stop_workers() {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      stopping = true;
+    }
+    wake.notify_all();
+    for (auto &thread : pool) thread.join();
+    pool.clear();
+  }
+
+  // culls boxes [first, last), first a multiple of lanes, writing the ids
+  // that survive to out
+  size_t cull_range(const Frustum &frustum, size_t first, size_t last, uint32_t *out) const {
+    size_t n = 0;
+    const float *cx = center[0].data(), *cy = center[1].data(), *cz = center[2].data();
+    const float *ex = extent[0].data(), *ey = extent[1].data(), *ez = extent[2].data();
+#if defined(__AVX__)
+    __m256 nx[6], ny[6], nz[6], ax[6], ay[6], az[6], w[6];
+    for (int p = 0; p < 6; ++p) {
+      const glm::vec4 &plane = frustum.planes[p];
+      nx[p] = _mm256_set1_ps(plane.x);
+      ny[p] = _mm256_set1_ps(plane.y);
+      nz[p] = _mm256_set1_ps(plane.z);
+      ax[p] = _mm256_set1_ps(std::abs(plane.x));
+      ay[p] = _mm256_set1_ps(std::abs(plane.y));
+      az[p] = _mm256_set1_ps(std::abs(plane.z));
+      w[p] = _mm256_set1_ps(plane.w);
+    }
+    const __m256 zero = _mm256_setzero_ps();
+    for (size_t i = first; i < last; i += 8) {
+      __m256 x = _mm256_loadu_ps(cx + i), y = _mm256_loadu_ps(cy + i), z = _mm256_loadu_ps(cz + i);
+      __m256 hx = _mm256_loadu_ps(ex + i), hy = _mm256_loadu_ps(ey + i), hz = _mm256_loadu_ps(ez + i);
+      int inside = 0xff;
+      for (int p = 0; p < 6 && inside; ++p) {
+        // signed distance of the center plus the box's reach towards the plane
+        __m256 d = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(nx[p], x), _mm256_mul_ps(ny[p], y)),
+                                 _mm256_add_ps(_mm256_mul_ps(nz[p], z), w[p]));
+        __m256 r = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(ax[p], hx), _mm256_mul_ps(ay[p], hy)),
+                                 _mm256_mul_ps(az[p], hz));
+        inside &= _mm256_movemask_ps(_mm256_cmp_ps(_mm256_add_ps(d, r), zero, _CMP_GE_OQ));
+      }
+      n = emit(inside, i, last, out, n);
+    }
+#elif defined(__SSE2__)
+    __m128 nx[6], ny[6], nz[6], ax[6], ay[6], az[6], w[6];
+    for (int p = 0; p < 6; ++p) {
+      const glm::vec4 &plane = frustum.planes[p];
+      nx[p] = _mm_set1_ps(plane.x);
+      ny[p] = _mm_set1_ps(plane.y);
+      nz[p] = _mm_set1_ps(plane.z);
+      ax[p] = _mm_set1_ps(std::abs(plane.x));
+      ay[p] = _mm_set1_ps(std::abs(plane.y));
+      az[p] = _mm_set1_ps(std::abs(plane.z));
+      w[p] = _mm_set1_ps(plane.w);
+    }
+    const __m128 zero = _mm_setzero_ps();
+    for (size_t i = first; i < last; i += 4) {
+      __m128 x = _mm_loadu_ps(cx + i), y = _mm_loadu_ps(cy + i), z = _mm_loadu_ps(cz + i);
+      __m128 hx = _mm_loadu_ps(ex + i), hy = _mm_loadu_ps(ey + i), hz = _mm_loadu_ps(ez + i);
+      int inside = 0xf;
+      for (int p = 0; p < 6 && inside; ++p) {
+        // signed distance of the center plus the box's reach towards the plane
+        __m128 d = _mm_add_ps(_mm_add_ps(_mm_mul_ps(nx[p], x), _mm_mul_ps(ny[p], y)),
+                              _mm_add_ps(_mm_mul_ps(nz[p], z), w[p]));
+        __m128 r = _mm_add_ps(_mm_add_ps(_mm_mul_ps(ax[p], hx), _mm_mul_ps(ay[p], hy)),
+                              _mm_mul_ps(az[p], hz));
+        inside &= _mm_movemask_ps(_mm_cmpge_ps(_mm_add_ps(d, r), zero));
+      }
+      n = emit(inside, i, last, out, n);
+    }
+#else
+    for (size_t i = first; i < last; ++i) {
+      bool inside = true;
+      for (int p = 0; p < 6 && inside; ++p) {
+        const glm::vec4 &plane = frustum.planes[p];
+        // summed in the same order as the vector paths so all agree exactly
+        float d = (plane.x*cx[i] + plane.y*cy[i]) + (plane.z*cz[i] + plane.w);
+        float r = (std::abs(plane.x)*ex[i] + std::abs(plane.y)*ey[i]) + std::abs(plane.z)*ez[i];
+        inside = d + r >= 0.0f;
+      }
+      if (inside) out[n++] = static_cast<uint32_t>(i);
+    }
+#endif
+    return n;
+  }
+
+  // writes the ids of the set bits of a register's mask, skipping padding
+  static size_t emit(int mask, size_t base, size_t last, uint32_t *out, size_t n) {
+    while (mask) {
+      int bit = __builtin_ctz(mask);
+      mask &= mask - 1;
+      if (base + bit < last) out[n++] = static_cast<uint32_t>(base + bit);
+    }
+    return n;
+  }
+};
+
+#endif
@@ -0,0 +1,73 @@
+#ifndef MESH_H
+#define MESH_H
+
+#include "glad/glad.h"
+#include "glm/glm.hpp"
+#include "glm/gtc/packing.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Packed vertex for indexed meshes, 12 bytes instead of 6 floats: integer
+// positions read as floats without normalizing, so meshes are modelled in
+// whole units and scaled by their model matrix, and a snorm 10_10_10_2
+// normal.
+struct MeshVertex {
+  int16_t position[4]; // xyz, w is padding
+  uint32_t normal;     // packSnorm3x10_1x2(normal, 0)
+};
+
+static_assert(sizeof(MeshVertex) == 12, "MeshVertex must be 12 packed bytes");
+
+struct Mesh {
+  std::vector<MeshVertex> vertices;
+  std::vector<uint16_t> indices;
+};
+
+inline MeshVertex mesh_vertex(const glm::ivec3 &position, const glm::vec3 &normal) {
+  MeshVertex v;
+  v.position[0] = static_cast<int16_t>(position.x);
+  v.position[1] = static_cast<int16_t>(position.y);
+  v.position[2] = static_cast<int16_t>(position.z);
+  v.position[3] = 0;
+  v.normal = glm::packSnorm3x10_1x2(glm::vec4(normal, 0.0f));
+  return v;
+}
+
+// the cube from -1 to 1, 4 vertices per face so each keeps its own normal,
+// counter-clockwise seen from outside
+inline Mesh cube_mesh() {
+  Mesh mesh;
+  for (int axis = 0; axis < 3; ++axis) {
+    for (int sign = -1; sign <= 1; sign += 2) {
+      glm::ivec3 n(0);
+      n[axis] = sign;
+      // u x v points along n
+      glm::ivec3 u(0), v(0);
+      u[(axis + 1) % 3] = 1;
+      v[(axis + 2) % 3] = sign;
+      uint16_t first = static_cast<uint16_t>(mesh.vertices.size());
+      const int corners[4][2] = {{-1, -1}, {1, -1}, {1, 1}, {-1, 1}};
+      for (const auto &c : corners) {
+        glm::ivec3 p = n + u*c[0] + v*c[1];
+        mesh.vertices.push_back(mesh_vertex(p, glm::vec3(n)));
+      }
+      const uint16_t quad[6] = {0, 1, 2, 2, 3, 0};
+      for (uint16_t i : quad)
+        mesh.indices.push_back(first + i);
+    }
+  }
+  return mesh;
+}
+
+// position at location 0 and normal at location 1, for MeshVertex data in
+// the bound GL_ARRAY_BUFFER
+inline void mesh_vertex_attributes() {
+  glVertexAttribPointer(0, 3, GL_SHORT, GL_FALSE, sizeof(MeshVertex), (void*)offsetof(MeshVertex, position));
+  glEnableVertexAttribArray(0);
+  glVertexAttribPointer(1, 4, GL_INT_2_10_10_10_REV, GL_TRUE, sizeof(MeshVertex), (void*)offsetof(MeshVertex, normal));
+  glEnableVertexAttribArray(1);
+}
+
+#endif
@@ -0,0 +1,203 @@
+#ifndef REACHABILITY_H
+#define REACHABILITY_H
+
+#include "course.h"
+#include "simulation.h"
+#include "glm/glm.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+
+// Checks whether each platform of a course can be jumped to from an earlier
+// one, from closed-form upper bounds on a jump instead of simulating it.
+// The bounds are optimistic, so a platform marked unreachable really can't
+// be reached while a reachable one may still be too hard in practice.
+//
+// Per jump from platform i to a lower (or slightly higher) platform j:
+//  - airtime T covers every tick the player moves before its feet drop
+//    below j's top, from the same per tick integration Simulation does
+//    (no gravity on the jump tick, then velocity before position), with a
+//    contact margin of slack at both ends and a tick more for rounding
+//  - strafing adds at most c to the squared horizontal speed each tick and
+//    air drag holds it at terminalSpeed, so from speed v the jump covers at
+//    most min(integral of sqrt(v^2 + c*t/dt), max(v, terminalSpeed)*T). The
+//    integral runs a tick past the last move so it bounds the per tick sum
+//  - drag is bounded by the least Simulation could apply: it scales x and
+//    then z by factors from the 3D speed, which vertical speed only makes
+//    stronger but the smaller x can make weaker for z
+//  - j counts as reached if that's at least the horizontal gap between
+//    where the player can stand on i and where it can stand on j
+// The speed bound carried onto j is what the jump could have grown it to.
+// A player can also build speed hopping on one platform, which is bounded by
+// having to turn around within one airtime to land on it again.
+//
+// analyze() runs the generator for a seed, or platforms can be fed in course
+// order with add(). Only a window of recent platforms is kept, so analyzing a
+// course allocates nothing.
+class ReachabilityAnalyzer {
+public:
+  static const size_t window = 16; // furthest back a jump can start from
+
+  float terminalSpeed; // horizontal speed air drag and strafing balance at
+  float hopSpeed;      // speed bound on any platform, without a run up
+
+  ReachabilityAnalyzer(const PhysicsParams &physics, const CourseParams &params)
+    : physics(physics), params(params), platformScale(params.platformScale) {
+    float dt = 1.0f / physics.tickRate;
+    float a = physics.maxGroundSpeed * physics.acceleration * dt; // speed added per tick at most
+    float m = physics.maxAirSpeed;
+    // best single tick strafe, wish direction at m - a to the velocity
+    speedSqGain = m >= a ? 2.0f*a*m - a*a : m*m;
+
+    // bisect for where one tick of strafing and drag leaves the speed alone
+    float lo = 0.0f, hi = 1000.0f;
+    for (int i = 0; i < 64; ++i) {
+      float v = (lo + hi) * 0.5f;
+      float strafed = std::sqrt(v*v + speedSqGain);
+      float dragged = strafed * least_drag(strafed);
+      (dragged > v ? lo : hi) = v;
+    }
+    terminalSpeed = hi;
+
+    // running on the ground settles where friction takes what a tick adds
+    float groundSpeed = a / (1.0f - physics.friction);
+    // hopping in place has to turn around within a flat jump's airtime, with
+    // at most a per tick of sideways acceleration
+    float flatAirtime = airtime(0.0f);
+    float turnSpeed = a / dt * flatAirtime / static_cast<float>(M_PI);
+    hopSpeed = std::min(terminalSpeed, std::max(groundSpeed, turnSpeed));
+
+    // the player stands on a platform while their boxes overlap
+    standHalf = glm::vec2(platformScale.x + physics.playerSize.x, platformScale.z + physics.playerSize.z) / 2.0f
+      + glm::vec2(physics.contactMargin);
+    reset();
+  }
+
+  void reset() {
+    count = 0;
+    unreachableCount = 0;
+    firstUnreachable = -1;
+  }
+
+  // analyzes the course for seed from scratch, true if it can be finished
+  bool analyze(uint64_t seed) {
+    reset();
+    CourseGenerator generator(seed, params);
+    glm::vec3 platform;
+    while (generator.next(platform))
+      add(platform);
+    return finishable();
+  }
+
+  // the next platform of the course, in platform units
+  void add(const glm::vec3 &platform) {
+    Entry &entry = entries[count % window];
+    entry.pos = platform * platformScale;
+    entry.reachable = false;
+    entry.speed = 0.0f;
+    if (count == 0) {
+      // the spawn drops the player straight onto the first platform
+      entry.reachable = true;
+      entry.speed = hopSpeed;
+    }
+    size_t first = count > window - 1 ? count - (window - 1) : 0;
+    for (size_t i = first; i < count; ++i) {
+      const Entry &from = entries[i % window];
+      if (!from.reachable) continue;
+      float speed;
+      if (!jump(from, entry, speed)) continue;
+      entry.reachable = true;
+      entry.speed = std::max(entry.speed, std::max(speed, hopSpeed));
+    }
+    if (!entry.reachable) {
+      ++unreachableCount;
+      if (firstUnreachable < 0) firstUnreachable = count;
+    }
+    ++count;
+  }
+
+  // whether the last platform added, the finish, can be reached
+  bool finishable() const {
+    return count > 0 && entries[(count - 1) % window].reachable;
+  }
+
+  size_t platforms() const { return count; }
+  size_t unreachable() const { return unreachableCount; }
+  // index of the first platform no jump reaches, -1 if there's none
+  int64_t first_unreachable() const { return firstUnreachable; }
+
+  // airtime of a jump that lands drop below where it took off, at least as
+  // long as any the simulation can do, negative if the jump doesn't get
+  // that high
+  float airtime(float drop) const {
+    // after tick n of the jump, the jump tick being 0, the player is
+    // dt*((n+1)*j - g*dt*n*(n+1)/2) above where it took off. It can stand
+    // up to contactMargin above i and still land contactMargin below j's top
+    float dt = 1.0f / physics.tickRate;
+    float j = physics.jumpForce;
+    float h = drop + 2.0f*physics.contactMargin;
+    float a = 0.5f*physics.g*dt;
+    float b = a - j;
+    float disc = b*b + 4.0f*a*(j + h/dt);
+    if (disc < 0.0f) return -1.0f;
+    // the tick it passes j's top is the first after the descending root,
+    // every tick up to it moves, the integral needs one more and one is
+    // slack for rounding
+    float root = (-b + std::sqrt(disc)) / (2.0f*a);
+    if (root < -1.0f) return -1.0f;
+    return (std::floor(std::max(root, 0.0f)) + 4.0f) * dt;
+  }
+
+  // the largest factor one air tick of drag can scale horizontal speed by.
+  // The sim's x factor is at most f(speed). If z holds at least half the
+  // squared speed, its factor is at most f(speed/sqrt(2)) and so is x's.
+  // Otherwise x holds over half and z's factor is at most 1
+  float least_drag(float speed) const {
+    auto f = [&](float v) {
+      return std::pow(physics.airDrag, std::pow(v/physics.airDragSpeed, physics.airDragExponent));
+    };
+    float fx = f(speed);
+    return std::max(f(speed / std::sqrt(2.0f)), std::sqrt((1.0f + fx*fx) / 2.0f));
+  }
+
+  // furthest horizontal distance covered in time starting at speed
+  float max_distance(float speed, float time) const {
+    float k = speedSqGain * physics.tickRate;
+    float v0 = speed;
+    if (k <= 0.0f) return v0 * time;
+    float grown = 2.0f / (3.0f*k) * (std::pow(v0*v0 + k*time, 1.5f) - v0*v0*v0);
+    return std::min(grown, std::max(v0, terminalSpeed) * time);
+  }
+
+private:
+  struct Entry {
+    glm::vec3 pos;  // world space center
+    float speed;    // horizontal speed bound while standing on it
+    bool reachable;
+  };
+
+  PhysicsParams physics;
+  CourseParams params;
+  glm::vec3 platformScale;
+  float speedSqGain;   // squared speed strafing can add in one tick
+  glm::vec2 standHalf; // player center offsets that still stand on a platform
+  Entry entries[window];
+  size_t count;
+  size_t unreachableCount;
+  int64_t firstUnreachable;
+
+  bool jump(const Entry &from, const Entry &to, float &landingSpeed) const {
+    float time = airtime(from.pos.y - to.pos.y);
+    if (time < 0.0f) return false;
+    glm::vec2 d = glm::abs(glm::vec2(to.pos.x - from.pos.x, to.pos.z - from.pos.z));
+    float gap = glm::length(glm::max(d - 2.0f*standHalf, glm::vec2(0.0f)));
+    if (max_distance(from.speed, time) < gap) return false;
+    float k = speedSqGain * physics.tickRate;
+    landingSpeed = std::min(std::sqrt(from.speed*from.speed + k*time), std::max(from.speed, terminalSpeed));
+    return true;
+  }
+};
+
+#endif
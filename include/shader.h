@@ -2,97 +2,345 @@
 #define SHADER_H
 
 #include "glad/glad.h"
+#include "glm/glm.hpp"
+#include "glm/gtc/type_ptr.hpp"
 
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
 #include <filesystem>
+#include <limits>
 #include <string>
+#include <vector>
 #include <fstream>
-#include <sstream>
 #include <iostream>
 
+// handle to a uniform of type T, got once from Shader::uniform() and then
+// set every frame without any name lookups. Uniforms the linker dropped get
+// location -1, which GL silently ignores.
+template <typename T>
+struct Uniform
+{
+  GLint location = -1;
+};
+
+// the GL type a uniform has to be declared with to take a T
+template <typename T> struct UniformType;
+template <> struct UniformType<bool> { static const GLenum value = GL_BOOL; };
+template <> struct UniformType<int> { static const GLenum value = GL_INT; };
+template <> struct UniformType<float> { static const GLenum value = GL_FLOAT; };
+template <> struct UniformType<glm::vec3> { static const GLenum value = GL_FLOAT_VEC3; };
+template <> struct UniformType<glm::vec4> { static const GLenum value = GL_FLOAT_VEC4; };
+template <> struct UniformType<glm::mat4> { static const GLenum value = GL_FLOAT_MAT4; };
+
+// from KHR_parallel_shader_compile (ARB_parallel_shader_compile has the same
+// values), which glad wasn't generated with
+#ifndef GL_COMPLETION_STATUS_KHR
+#define GL_COMPLETION_STATUS_KHR 0x91B1
+#endif
+#ifndef GL_MAX_SHADER_COMPILER_THREADS_KHR
+#define GL_MAX_SHADER_COMPILER_THREADS_KHR 0x91B0
+#endif
+
+// what's written in front of a cached program binary
+struct ProgramBinaryHeader
+{
+  char magic[4];   // "GESB"
+  uint32_t format; // from glGetProgramBinary
+  uint64_t key;    // Shader::cacheKey() of what it was built from
+  uint64_t length;
+};
+
 class Shader
   {
   public:
     unsigned int ID;
-    // constructor generates the shader on the fly
+    // set when the driver can report whether a program has finished
+    // compiling without waiting for it, see ShaderManager
+    static inline bool completionQueries = false;
+
+    // constructor hands the source code to the driver and returns without waiting
+    // for them to compile and link, the results are checked on first use.
+    // With a cacheDir the linked program is kept there as a driver binary and
+    // loaded from it next time, as long as the sources and the driver are the
+    // same; anything else falls back to compiling
     // ------------------------------------------------------------------------
-    Shader(const std::filesystem::path &vertexPath, const std::filesystem::path &fragmentPath)
+    Shader(const std::string &vertexCode, const std::string &fragmentCode,
+           const std::filesystem::path &cacheDir = std::filesystem::path())
     {
-      // 1. retrieve the vertex/fragment source code from filePath
-      std::string vertexCode;
-      std::string fragmentCode;
-      std::ifstream vShaderFile;
-      std::ifstream fShaderFile;
-      // ensure ifstream objects can throw exceptions:
-      vShaderFile.exceptions (std::ifstream::failbit | std::ifstream::badbit);
-      fShaderFile.exceptions (std::ifstream::failbit | std::ifstream::badbit);
-      try 
-      {
-        // open files
-        vShaderFile.open(vertexPath);
-        fShaderFile.open(fragmentPath);
-        std::stringstream vShaderStream, fShaderStream;
-        // read file's buffer contents into streams
-        vShaderStream << vShaderFile.rdbuf();
-        fShaderStream << fShaderFile.rdbuf();
-        // close file handlers
-        vShaderFile.close();
-        fShaderFile.close();
-        // convert stream into string
-        vertexCode   = vShaderStream.str();
-        fragmentCode = fShaderStream.str();
-      }
-      catch (std::ifstream::failure& e)
+      // 1. sources come from load_asset() or anywhere else, no files here
+      // 2. try the program binary cache
+      caching = !cacheDir.empty() && binariesSupported();
+      if (caching)
       {
-        std::cout << "ERROR::SHADER::FILE_NOT_SUCCESSFULLY_READ: " << e.what() << std::endl;
+        key = cacheKey(vertexCode, fragmentCode);
+        char name[32];
+        std::snprintf(name, sizeof(name), "%016llx.bin", static_cast<unsigned long long>(key));
+        cachePath = cacheDir / name;
+        ID = glCreateProgram();
+        if (loadBinary(cachePath, key))
+        {
+          finished = true;
+          reflectUniforms();
+          return;
+        }
+        glDeleteProgram(ID);
       }
       const char* vShaderCode = vertexCode.c_str();
       const char * fShaderCode = fragmentCode.c_str();
-      // 2. compile shaders
-      unsigned int vertex, fragment;
+      // 3. compile shaders, nothing here waits for the driver
       // vertex shader
       vertex = glCreateShader(GL_VERTEX_SHADER);
       glShaderSource(vertex, 1, &vShaderCode, NULL);
       glCompileShader(vertex);
-      checkCompileErrors(vertex, "VERTEX");
       // fragment Shader
       fragment = glCreateShader(GL_FRAGMENT_SHADER);
       glShaderSource(fragment, 1, &fShaderCode, NULL);
       glCompileShader(fragment);
-      checkCompileErrors(fragment, "FRAGMENT");
       // shader Program
       ID = glCreateProgram();
+      if (caching)
+        glProgramParameteri(ID, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
       glAttachShader(ID, vertex);
       glAttachShader(ID, fragment);
       glLinkProgram(ID);
+    }
+    // whether the program can be used without waiting on the driver. Without
+    // completion queries that can't be known, so it's always true and the
+    // first use waits
+    // ------------------------------------------------------------------------
+    bool ready() const
+    {
+      if (finished || !completionQueries)
+        return true;
+      GLint done = 0;
+      glGetProgramiv(ID, GL_COMPLETION_STATUS_KHR, &done);
+      return done;
+    }
+    // checks how compiling and linking went, once, waiting for them if they
+    // haven't finished. Everything below that needs the linked program calls
+    // it first
+    // ------------------------------------------------------------------------
+    void finish()
+    {
+      if (finished)
+        return;
+      finished = true;
+      checkCompileErrors(vertex, "VERTEX");
+      checkCompileErrors(fragment, "FRAGMENT");
       checkCompileErrors(ID, "PROGRAM");
       // delete the shaders as they're linked into our program now and no longer necessary
       glDeleteShader(vertex);
       glDeleteShader(fragment);
+      if (caching)
+        saveBinary(cachePath, key);
+      reflectUniforms();
     }
     // activate the shader
     // ------------------------------------------------------------------------
     void use() 
     { 
+      finish();
       glUseProgram(ID); 
     }
-    // utility uniform functions
+    // typed handle to an active uniform, meant to be looked up once after
+    // construction. A uniform declared with another type gets a dead handle
     // ------------------------------------------------------------------------
-    void setBool(const std::string &name, bool value) const
+    template <typename T>
+    Uniform<T> uniform(const char *name)
+    {
+      finish();
+      Uniform<T> handle;
+      const ActiveUniform *active = find(name);
+      if (!active)
+        return handle;
+      if (active->type != UniformType<T>::value)
+      {
+        std::cout << "ERROR::SHADER::UNIFORM_TYPE_MISMATCH: " << name << std::endl;
+        return handle;
+      }
+      handle.location = active->location;
+      return handle;
+    }
+    // points a uniform block at a buffer binding point, if the program has it
+    // ------------------------------------------------------------------------
+    void bindUniformBlock(const char *name, GLuint binding)
+    {
+      finish();
+      GLuint index = glGetUniformBlockIndex(ID, name);
+      if (index != GL_INVALID_INDEX)
+        glUniformBlockBinding(ID, index, binding);
+    }
+    // setters for the program in use, no driver lookups
+    // ------------------------------------------------------------------------
+    void set(Uniform<bool> u, bool value) const { glUniform1i(u.location, (int)value); }
+    void set(Uniform<int> u, int value) const { glUniform1i(u.location, value); }
+    void set(Uniform<float> u, float value) const { glUniform1f(u.location, value); }
+    void set(Uniform<glm::vec3> u, const glm::vec3 &value) const { glUniform3fv(u.location, 1, glm::value_ptr(value)); }
+    void set(Uniform<glm::vec4> u, const glm::vec4 &value) const { glUniform4fv(u.location, 1, glm::value_ptr(value)); }
+    void set(Uniform<glm::mat4> u, const glm::mat4 &value) const { glUniformMatrix4fv(u.location, 1, GL_FALSE, glm::value_ptr(value)); }
+    // utility uniform functions, by name through the reflected table, for
+    // the program in use
+    // ------------------------------------------------------------------------
+    void setBool(const char *name, bool value) const
     {         
-      glUniform1i(glGetUniformLocation(ID, name.c_str()), (int)value); 
+      glUniform1i(location(name), (int)value); 
     }
     // ------------------------------------------------------------------------
-    void setInt(const std::string &name, int value) const
+    void setInt(const char *name, int value) const
     { 
-      glUniform1i(glGetUniformLocation(ID, name.c_str()), value); 
+      glUniform1i(location(name), value); 
     }
     // ------------------------------------------------------------------------
-    void setFloat(const std::string &name, float value) const
+    void setFloat(const char *name, float value) const
     { 
-      glUniform1f(glGetUniformLocation(ID, name.c_str()), value); 
+      glUniform1f(location(name), value); 
     }
 
   private:
+    bool finished = false;
+    unsigned int vertex = 0, fragment = 0;
+    bool caching = false;
+    std::filesystem::path cachePath;
+    uint64_t key = 0;
+
+    // program binaries are core in GL 4.1, the context we ask for is 3.3 so
+    // it depends on what the driver actually gave us
+    // ------------------------------------------------------------------------
+    static bool binariesSupported()
+    {
+      if (!GLAD_GL_VERSION_4_1)
+        return false;
+      GLint formats = 0;
+      glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+      return formats > 0;
+    }
+    // FNV-1a over the sources and whatever identifies the driver, a binary
+    // is only valid for the exact driver that produced it
+    // ------------------------------------------------------------------------
+    static uint64_t cacheKey(const std::string &vertexCode, const std::string &fragmentCode)
+    {
+      uint64_t hash = 14695981039346656037ull;
+      auto add = [&](const char *text, size_t length)
+      {
+        for (size_t i = 0; i < length; ++i)
+          hash = (hash ^ static_cast<unsigned char>(text[i])) * 1099511628211ull;
+        // separator, so moving text between fields changes the key
+        hash = (hash ^ 0xff) * 1099511628211ull;
+      };
+      add(vertexCode.data(), vertexCode.size());
+      add(fragmentCode.data(), fragmentCode.size());
+      for (GLenum name : {GL_VENDOR, GL_RENDERER, GL_VERSION})
+      {
+        const char *value = reinterpret_cast<const char*>(glGetString(name));
+        if (value)
+          add(value, std::strlen(value));
+      }
+      return hash;
+    }
+    // loads a cached binary into ID, false if it's missing, stale or the
+    // driver rejects it
+    // ------------------------------------------------------------------------
+    bool loadBinary(const std::filesystem::path &path, uint64_t key)
+    {
+      std::ifstream file(path, std::ios::binary);
+      ProgramBinaryHeader header;
+      if (!file.read(reinterpret_cast<char*>(&header), sizeof(header))
+          || std::memcmp(header.magic, "GESB", 4) != 0 || header.key != key)
+        return false;
+      // the length comes from the file, so it has to agree with the file
+      // before it's trusted with an allocation
+      std::error_code error;
+      uintmax_t fileSize = std::filesystem::file_size(path, error);
+      if (error || header.length == 0 || fileSize < sizeof(header)
+          || header.length != fileSize - sizeof(header)
+          || header.length > static_cast<uint64_t>(std::numeric_limits<GLsizei>::max()))
+        return false;
+      std::vector<char> binary(header.length);
+      if (!file.read(binary.data(), binary.size()))
+        return false;
+      glProgramBinary(ID, header.format, binary.data(), binary.size());
+      GLint success = 0;
+      glGetProgramiv(ID, GL_LINK_STATUS, &success);
+      return success;
+    }
+    // writes the linked program to the cache, through a temporary file so a
+    // second instance never reads half of one
+    // ------------------------------------------------------------------------
+    void saveBinary(const std::filesystem::path &path, uint64_t key)
+    {
+      GLint success = 0, length = 0;
+      glGetProgramiv(ID, GL_LINK_STATUS, &success);
+      glGetProgramiv(ID, GL_PROGRAM_BINARY_LENGTH, &length);
+      if (!success || length <= 0)
+        return;
+      ProgramBinaryHeader header;
+      std::memcpy(header.magic, "GESB", 4);
+      std::vector<char> binary(length);
+      GLsizei written = 0;
+      glGetProgramBinary(ID, length, &written, &header.format, binary.data());
+      header.key = key;
+      header.length = written;
+
+      std::error_code error;
+      std::filesystem::create_directories(path.parent_path(), error);
+      std::filesystem::path temp = path;
+      temp += ".tmp";
+      {
+        std::ofstream file(temp, std::ios::binary);
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        file.write(binary.data(), written);
+        if (!file)
+          return;
+      }
+      std::filesystem::rename(temp, path, error);
+    }
+    struct ActiveUniform
+    {
+      std::string name;
+      GLint location;
+      GLenum type;
+    };
+    std::vector<ActiveUniform> uniforms;
+
+    // reads every active uniform's name, type and location once after linking
+    // ------------------------------------------------------------------------
+    void reflectUniforms()
+    {
+      GLint count = 0, maxLength = 0;
+      glGetProgramiv(ID, GL_ACTIVE_UNIFORMS, &count);
+      glGetProgramiv(ID, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+      std::vector<char> name(maxLength + 1);
+      for (GLint i = 0; i < count; ++i)
+      {
+        GLsizei length = 0;
+        GLint size = 0;
+        GLenum type = 0;
+        glGetActiveUniform(ID, i, name.size(), &length, &size, &type, name.data());
+        std::string uniformName(name.data(), length);
+        // arrays are reported as "name[0]"
+        if (uniformName.size() > 3 && uniformName.compare(uniformName.size() - 3, 3, "[0]") == 0)
+          uniformName.resize(uniformName.size() - 3);
+        GLint loc = glGetUniformLocation(ID, uniformName.c_str());
+        // uniforms in blocks have no location of their own
+        if (loc >= 0)
+          uniforms.push_back(ActiveUniform{uniformName, loc, type});
+      }
+    }
+    // ------------------------------------------------------------------------
+    const ActiveUniform *find(const char *name) const
+    {
+      for (const ActiveUniform &u : uniforms)
+        if (std::strcmp(u.name.c_str(), name) == 0)
+          return &u;
+      return nullptr;
+    }
+    // ------------------------------------------------------------------------
+    GLint location(const char *name) const
+    {
+      const ActiveUniform *active = find(name);
+      return active ? active->location : -1;
+    }
     // utility function for checking shader compilation/linking errors.
     // ------------------------------------------------------------------------
     void checkCompileErrors(unsigned int shader, std::string type)
@@ -0,0 +1,63 @@
+#ifndef SHADER_MANAGER_H
+#define SHADER_MANAGER_H
+
+#include "glad/glad.h"
+#include "shader.h"
+
+#include <cstring>
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Owns every program and submits them all up front, so the driver compiles
+// them while the rest of startup runs and the first frames are drawn. Each
+// Shader only waits for its own results when it's first used.
+//
+// With KHR_parallel_shader_compile (or the ARB version) the driver compiles
+// on its own threads and Shader::ready() can tell when a program is done
+// without blocking, so callers can skip what isn't ready yet. glad wasn't
+// generated with either extension, so its one function is loaded here.
+class ShaderManager {
+public:
+  // load is the same function glad was loaded with
+  explicit ShaderManager(GLADloadproc load) {
+    const char *suffix = has_extension("GL_KHR_parallel_shader_compile") ? "KHR"
+      : has_extension("GL_ARB_parallel_shader_compile") ? "ARB" : nullptr;
+    if (!suffix)
+      return;
+    std::string name = std::string("glMaxShaderCompilerThreads") + suffix;
+    auto maxThreads = reinterpret_cast<void (*)(GLuint)>(load(name.c_str()));
+    // all the driver wants
+    if (maxThreads)
+      maxThreads(0xFFFFFFFFu);
+    Shader::completionQueries = true;
+  }
+
+  Shader &add(const std::string &vertexCode, const std::string &fragmentCode,
+              const std::filesystem::path &cacheDir = std::filesystem::path()) {
+    programs.push_back(std::make_unique<Shader>(vertexCode, fragmentCode, cacheDir));
+    return *programs.back();
+  }
+
+  bool all_ready() const {
+    for (const auto &program : programs)
+      if (!program->ready()) return false;
+    return true;
+  }
+
+private:
+  std::vector<std::unique_ptr<Shader>> programs;
+
+  static bool has_extension(const char *name) {
+    GLint count = 0;
+    glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+    for (GLint i = 0; i < count; ++i) {
+      const char *extension = reinterpret_cast<const char*>(glGetStringi(GL_EXTENSIONS, i));
+      if (extension && std::strcmp(extension, name) == 0) return true;
+    }
+    return false;
+  }
+};
+
+#endif
@@ -0,0 +1,298 @@
+#ifndef SIMULATION_H
+#define SIMULATION_H
+
+#include "aabb.h"
+#include "bvh.h"
+#include "world.h"
+#include "glm/glm.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+struct PhysicsParams {
+  float tickRate = 128.0f;
+  float g = 3.5f;
+  float friction = 0.7f;
+  float maxGroundSpeed = 10.0f;
+  float maxAirSpeed = 1.0f;
+  float acceleration = 5.0f;
+  // float airAcceleration = 0.1f;
+  float jumpForce = 1.3f;
+  glm::vec3 playerSize = glm::vec3(0.65f, 0.6f, 0.65f);
+  // air drag, horizontal speed is scaled by airDrag^((speed/airDragSpeed)^airDragExponent) every air tick
+  float airDrag = 0.99f;
+  float airDragSpeed = 20.0f;
+  float airDragExponent = 1.1f;
+  // gap move_player() leaves between the player and a surface it hits
+  float skin = 0.001f;
+  // distance within which a surface still counts as touching
+  float contactMargin = 0.01f;
+};
+
+// Every float of PhysicsParams, in the one order demos store them and
+// comparisons check them. A new field goes here too, the static_assert
+// below catches one that doesn't.
+#define PHYSICS_PARAMS_FIELDS(X) \
+  X(tickRate) X(g) X(friction) X(maxGroundSpeed) X(maxAirSpeed) X(acceleration) X(jumpForce) \
+  X(playerSize.x) X(playerSize.y) X(playerSize.z) \
+  X(airDrag) X(airDragSpeed) X(airDragExponent) X(skin) X(contactMargin)
+
+#define PHYSICS_PARAMS_COUNT(field) + 1
+const size_t physicsParamCount = 0 PHYSICS_PARAMS_FIELDS(PHYSICS_PARAMS_COUNT);
+#undef PHYSICS_PARAMS_COUNT
+static_assert(sizeof(PhysicsParams) == physicsParamCount * sizeof(float),
+              "PhysicsParams has a field PHYSICS_PARAMS_FIELDS doesn't list");
+
+// calls visit(field) on every field in PHYSICS_PARAMS_FIELDS order, params
+// can be const
+template <typename Params, typename Visit>
+void for_each_physics_param(Params &params, Visit &&visit) {
+#define PHYSICS_PARAMS_VISIT(field) visit(params.field);
+  PHYSICS_PARAMS_FIELDS(PHYSICS_PARAMS_VISIT)
+#undef PHYSICS_PARAMS_VISIT
+}
+
+// bit for bit, which is what it takes for a run to replay the same
+inline bool same_physics_params(const PhysicsParams &a, const PhysicsParams &b) {
+  float fa[physicsParamCount], fb[physicsParamCount];
+  size_t na = 0, nb = 0;
+  for_each_physics_param(a, [&](float f) { fa[na++] = f; });
+  for_each_physics_param(b, [&](float f) { fb[nb++] = f; });
+  return std::memcmp(fa, fb, sizeof(fa)) == 0;
+}
+
+// buttons held during a tick plus where the player is looking
+struct TickInput {
+  bool forward = false;
+  bool back = false;
+  bool left = false;
+  bool right = false;
+  bool jump = false;
+  float yaw = -90.0f; // degrees, same convention as the camera
+  float pitch = 0.0f;
+};
+
+enum class TickEvent {
+  None,
+  Respawn, // fell below the course
+  Finish,  // landed on the finish platform
+};
+
+// lastPlatform before the player has stood on anything
+const uint32_t noPlatform = UINT32_MAX;
+
+// contacts of the player with the platforms, computed once per tick by
+// player_collision() and read by everything else during the tick. Fixed
+// capacity so filling it never touches the heap.
+struct ContactSet {
+  static const size_t capacity = 16;
+  bool grounded = false;
+  bool overflow = false; // more contacts than capacity, extras were dropped
+  size_t count = 0;
+  glm::vec3 normals[capacity];
+  uint32_t platforms[capacity]; // world's platform id per normal
+
+  void clear() {
+    grounded = false;
+    overflow = false;
+    count = 0;
+  }
+
+  void add(const glm::vec3 &normal, uint32_t platform) {
+    if (count == capacity) {
+      overflow = true;
+      return;
+    }
+    if (normal == glm::vec3(0.0f, 1.0f, 0.0f)) grounded = true;
+    normals[count] = normal;
+    platforms[count] = platform;
+    ++count;
+  }
+};
+
+// Player movement and collision against a world, advanced in fixed ticks.
+// Knows nothing about windows or GL so it can run headless.
+class Simulation {
+public:
+  PhysicsParams params;
+  float tickTime;
+  const World &world;
+
+  glm::vec3 cameraPos;
+  glm::vec3 prevCameraPos; // cameraPos before the last tick, for interpolation
+  glm::vec3 playerVel;
+  float totalTime;
+  float finishTime = 0.0f; // totalTime of the last finished run
+  uint32_t lastPlatform = noPlatform; // platform last stood on since spawning
+  ContactSet contacts;
+
+  Simulation(const World &world, const PhysicsParams &params = PhysicsParams())
+    : params(params), tickTime(1.0f / params.tickRate), world(world) {
+    respawn();
+  }
+
+  void respawn() {
+    totalTime = 0.0f;
+    playerVel = glm::vec3(0.0f, 0.0f, 0.0f);
+    cameraPos = world.spawn_point();
+    // teleport, don't interpolate from where we were
+    prevCameraPos = cameraPos;
+    lastPlatform = noPlatform;
+    player_collision(contacts);
+  }
+
+  // for when the world moves its origin, keeps the player where it was
+  // relative to the platforms
+  void shift_origin(const glm::vec3 &offset) {
+    cameraPos += offset;
+    prevCameraPos += offset;
+  }
+
+  TickEvent tick(const TickInput &input) {
+    prevCameraPos = cameraPos;
+    totalTime += tickTime;
+    process_input(input);
+    return physics_update();
+  }
+
+  bool is_grounded() const {
+    return contacts.grounded;
+    // return cameraPos.y - playerSize.y < 0.01f;
+  }
+
+  AABB player_bounds() const {
+    const glm::vec3 &playerSize = params.playerSize;
+    return AABB{cameraPos - glm::vec3(playerSize.x/2.0f, playerSize.y, playerSize.z/2.0f),
+                cameraPos + glm::vec3(playerSize.x/2.0f, 0.0f, playerSize.z/2.0f)};
+  }
+
+private:
+  void process_input(const TickInput &input) {
+    if (input.jump && is_grounded())
+      playerVel.y = params.jumpForce;
+
+    const glm::vec3 up = glm::vec3(0.0f, 1.0f, 0.0f);
+    glm::vec3 wishDir = glm::vec3(0.0f, 0.0f, 0.0f);
+    glm::vec3 dir = glm::vec3(std::cos(glm::radians(input.yaw)), 0.0f, std::sin(glm::radians(input.yaw)));
+    if (input.forward)
+      wishDir += dir;
+    if (input.back)
+      wishDir += -dir;
+    if (input.left)
+      wishDir += -glm::normalize(glm::cross(dir, up));
+    if (input.right)
+      wishDir += glm::normalize(glm::cross(dir, up));
+    if (wishDir != glm::vec3(0.0f, 0.0f, 0.0f))
+      wishDir = glm::normalize(wishDir);
+
+    player_movement(wishDir, input.jump);
+  }
+
+  void player_movement(glm::vec3 wishDir, bool jump) {
+    float maxAccel = params.maxGroundSpeed * params.acceleration;
+    if (is_grounded() && !jump) {
+      playerVel.x *= params.friction;
+      playerVel.z *= params.friction;
+
+      float currentSpeed = glm::dot(glm::vec3(playerVel.x, 0, playerVel.z), wishDir);
+      float addSpeed = params.maxGroundSpeed - currentSpeed > maxAccel * tickTime ? maxAccel * tickTime
+        : (params.maxGroundSpeed - currentSpeed < 0 ? 0 : params.maxGroundSpeed - currentSpeed);
+      playerVel += addSpeed * wishDir;
+    } else {
+      float currentSpeed = glm::dot(glm::vec3(playerVel.x, 0, playerVel.z), wishDir);
+      // clamps value
+      float addSpeed = params.maxAirSpeed - currentSpeed > maxAccel * tickTime ? maxAccel * tickTime
+        : (params.maxAirSpeed - currentSpeed < 0 ? 0 : params.maxAirSpeed - currentSpeed);
+      playerVel += addSpeed * wishDir;
+      playerVel.x *= std::pow(params.airDrag, std::pow(glm::length(playerVel)/params.airDragSpeed, params.airDragExponent));
+      playerVel.z *= std::pow(params.airDrag, std::pow(glm::length(playerVel)/params.airDragSpeed, params.airDragExponent));
+    }
+
+    for (size_t i = 0; i < contacts.count; ++i) {
+      const glm::vec3 &normal = contacts.normals[i];
+      glm::vec3 u = -normal;
+      if (glm::dot(playerVel, u) > 0)
+        playerVel -= glm::dot(playerVel, u)*u;
+    }
+  }
+
+  TickEvent physics_update() {
+    if (!is_grounded())
+      playerVel.y -= params.g * tickTime;
+    else
+      playerVel.y = std::max(playerVel.y, 0.0f);
+    glm::vec3 delta = playerVel * tickTime;
+    // stay on the ground instead of hovering anywhere inside contactMargin
+    if (is_grounded() && playerVel.y <= 0.0f)
+      delta.y -= params.contactMargin;
+    move_player(delta);
+    // the only place contacts are refreshed, the next tick reads these
+    player_collision(contacts);
+    if (cameraPos.y <= world.respawn_height()) {
+      respawn();
+      return TickEvent::Respawn;
+    }
+    bool finished = false;
+    for (size_t i = 0; i < contacts.count; ++i) {
+      if (contacts.normals[i] != glm::vec3(0.0f, 1.0f, 0.0f)) continue;
+      lastPlatform = contacts.platforms[i];
+      finished = finished || world.is_finish(lastPlatform);
+    }
+    if (finished) {
+      finishTime = totalTime;
+      respawn();
+      return TickEvent::Finish;
+    }
+    return TickEvent::None;
+  }
+
+  void player_collision(ContactSet &contacts) const {
+    contacts.clear();
+    // move_player() leaves a gap of skin between the player and whatever it
+    // hit, so look a little further than the player's bounds for contacts
+    AABB player = player_bounds();
+    player.min -= glm::vec3(params.contactMargin);
+    player.max += glm::vec3(params.contactMargin);
+
+    uint32_t ids[ContactSet::capacity];
+    AABB platforms[ContactSet::capacity];
+    size_t count = world.overlap(player, ids, platforms, ContactSet::capacity);
+    for (size_t i = 0; i < std::min(count, ContactSet::capacity); ++i) {
+      const AABB &platform = platforms[i];
+      // the contact face is the axis we're least inside of
+      glm::vec3 depth = glm::min(player.max - platform.min, platform.max - player.min);
+      int axis = depth.x < depth.y ? (depth.x < depth.z ? 0 : 2) : (depth.y < depth.z ? 1 : 2);
+      glm::vec3 normal = glm::vec3(0.0f);
+      normal[axis] = player.max[axis] + player.min[axis] > platform.max[axis] + platform.min[axis] ? 1.0f : -1.0f;
+      contacts.add(normal, ids[i]);
+    }
+    contacts.overflow = contacts.overflow || count > ContactSet::capacity;
+  }
+
+  // moves the player by delta, stopping at the first platform in the way and
+  // sliding along its face with whatever movement is left, so fast moves
+  // can't tunnel through thin platforms
+  void move_player(glm::vec3 delta) {
+    const int maxSlides = 4;
+    for (int i = 0; i < maxSlides && delta != glm::vec3(0.0f); ++i) {
+      BVHHit hit;
+      if (!world.sweep(player_bounds(), delta, hit)) {
+        cameraPos += delta;
+        return;
+      }
+      // stop at the surface, backed off by skin so the next sweep doesn't
+      // start out touching it
+      cameraPos += delta * hit.t + hit.normal * params.skin;
+      delta *= 1.0f - hit.t;
+      // clip what's left of the move and the velocity against the face
+      delta -= glm::dot(delta, hit.normal) * hit.normal;
+      if (glm::dot(playerVel, hit.normal) < 0.0f)
+        playerVel -= glm::dot(playerVel, hit.normal) * hit.normal;
+    }
+  }
+};
+
+#endif
@@ -0,0 +1,88 @@
+#ifndef SPATIAL_HASH_H
+#define SPATIAL_HASH_H
+
+#include "aabb.h"
+#include "glm/glm.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+// Uniform grid hashed into a fixed bucket table. Each item is bucketed by a
+// single point (e.g. its center), so queries must grow their box by the
+// largest item half-extent to find everything that could touch it.
+class SpatialHash {
+public:
+  SpatialHash(float cellSize = 1.0f, size_t bucketCount = 1024)
+    : invCellSize(1.0f / cellSize), mask(bucket_pow2(bucketCount) - 1),
+      heads(mask + 1, -1) {}
+
+  void insert(uint32_t id, const glm::vec3 &point) {
+    if (id >= next.size()) {
+      next.resize(id + 1, -1);
+      cells.resize(id + 1);
+    }
+    glm::ivec3 cell = cell_of(point);
+    size_t bucket = bucket_of(cell);
+    cells[id] = cell;
+    next[id] = heads[bucket];
+    heads[bucket] = static_cast<int32_t>(id);
+  }
+
+  void remove(uint32_t id) {
+    int32_t *link = &heads[bucket_of(cells[id])];
+    while (*link != -1 && *link != static_cast<int32_t>(id))
+      link = &next[*link];
+    if (*link != -1)
+      *link = next[id];
+    next[id] = -1;
+  }
+
+  void clear() {
+    std::fill(heads.begin(), heads.end(), -1);
+  }
+
+  // calls visit(id) for every item whose cell overlaps box
+  template <typename Visit>
+  void query(const AABB &box, Visit &&visit) const {
+    glm::ivec3 lo = cell_of(box.min);
+    glm::ivec3 hi = cell_of(box.max);
+    for (int x = lo.x; x <= hi.x; ++x)
+      for (int y = lo.y; y <= hi.y; ++y)
+        for (int z = lo.z; z <= hi.z; ++z) {
+          glm::ivec3 cell(x, y, z);
+          for (int32_t id = heads[bucket_of(cell)]; id != -1; id = next[id]) {
+            // different cells can share a bucket
+            if (cells[id] == cell)
+              visit(static_cast<uint32_t>(id));
+          }
+        }
+  }
+
+private:
+  float invCellSize;
+  size_t mask;
+  std::vector<int32_t> heads;     // first item per bucket
+  std::vector<int32_t> next;      // next item in the same bucket
+  std::vector<glm::ivec3> cells;  // cell each item was inserted into
+
+  static size_t bucket_pow2(size_t n) {
+    size_t p = 1;
+    while (p < n) p <<= 1;
+    return p;
+  }
+
+  glm::ivec3 cell_of(const glm::vec3 &point) const {
+    return glm::ivec3(glm::floor(point * invCellSize));
+  }
+
+  size_t bucket_of(const glm::ivec3 &cell) const {
+    uint32_t h = static_cast<uint32_t>(cell.x) * 73856093u
+      ^ static_cast<uint32_t>(cell.y) * 19349663u
+      ^ static_cast<uint32_t>(cell.z) * 83492791u;
+    return h & mask;
+  }
+};
+
+#endif
@@ -0,0 +1,157 @@
+#ifndef STREAM_BUFFER_H
+#define STREAM_BUFFER_H
+
+#include "glad/glad.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+
+// Ring buffer for data written every frame (instances, per-frame uniforms,
+// anything streamed). It's split into one region per frame in flight and
+// each frame's region is fenced once its draws are submitted, so the CPU
+// only writes where the GPU has finished reading and no upload waits on
+// orphaning or an implicit sync. allocate() hands out pieces of the current
+// region, the buffer can be bound to any target with the returned offset.
+//
+// With GL 4.4 the whole buffer is created with glBufferStorage and stays
+// mapped, persistent and coherent, for the whole run. The context we ask for
+// is 3.3, so when the driver gives less each frame's region is mapped
+// unsynchronized instead (the fence already makes that safe) and unmapped
+// again before drawing.
+//
+// per frame:  begin_frame(), allocate() and write, end_writes(), draw,
+//             end_frame()
+class StreamBuffer {
+public:
+  static const unsigned framesInFlight = 3;
+
+  explicit StreamBuffer(size_t frameSize) {
+    GLint alignment = 0;
+    glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+    uniformAlignment = std::max<GLint>(alignment, 16);
+    persistent = GLAD_GL_VERSION_4_4;
+    create(frameSize);
+  }
+  StreamBuffer(const StreamBuffer&) = delete;
+  StreamBuffer &operator=(const StreamBuffer&) = delete;
+
+  GLuint buffer() const { return id; }
+  // what uniform block ranges have to be aligned to
+  size_t uniform_alignment() const { return uniformAlignment; }
+
+  // waits until the GPU is done with the region this frame reuses
+  void begin_frame() {
+    region = (region + 1) % framesInFlight;
+    wait(fences[region]);
+    fences[region] = nullptr;
+    used = 0;
+    if (persistent) {
+      regionData = mapped + region * regionSize;
+    } else {
+      glBindBuffer(GL_ARRAY_BUFFER, id);
+      void *p = glMapBufferRange(GL_ARRAY_BUFFER, region * regionSize, regionSize,
+                                 GL_MAP_WRITE_BIT | GL_MAP_UNSYNCHRONIZED_BIT | GL_MAP_INVALIDATE_RANGE_BIT);
+      glBindBuffer(GL_ARRAY_BUFFER, 0);
+      regionData = static_cast<uint8_t*>(p);
+    }
+  }
+
+  // size bytes in this frame's region, offset is from the start of the
+  // buffer. nullptr when the region is full, reserve() more up front
+  void *allocate(size_t size, size_t alignment, GLintptr &offset) {
+    size_t start = (used + alignment - 1) / alignment * alignment;
+    if (!regionData || start + size > regionSize) return nullptr;
+    used = start + size;
+    offset = region * regionSize + start;
+    return regionData + start;
+  }
+
+  // before drawing with anything written this frame
+  void end_writes() {
+    if (persistent) return;
+    glBindBuffer(GL_ARRAY_BUFFER, id);
+    glUnmapBuffer(GL_ARRAY_BUFFER);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    regionData = nullptr;
+  }
+
+  // after the frame's draws, the region is free again once they've run
+  void end_frame() {
+    fences[region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+  }
+
+  // makes each frame's region at least frameSize bytes. Waits for every
+  // frame in flight and moves to a new buffer, so it's for startup or the
+  // rare frame that needs more, before begin_frame()
+  void reserve(size_t frameSize) {
+    if (frameSize <= regionSize) return;
+    destroy();
+    create(std::max(frameSize, regionSize * 2));
+  }
+
+  // needs the context, so it's called before it goes away
+  void destroy() {
+    for (GLsync &fence : fences) {
+      wait(fence);
+      fence = nullptr;
+    }
+    if (persistent) {
+      glBindBuffer(GL_ARRAY_BUFFER, id);
+      glUnmapBuffer(GL_ARRAY_BUFFER);
+      glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+    glDeleteBuffers(1, &id);
+    id = 0;
+  }
+
+private:
+  GLuint id = 0;
+  bool persistent = false;
+  size_t regionSize = 0;
+  size_t uniformAlignment = 16;
+  unsigned region = 0;
+  size_t used = 0;
+  uint8_t *mapped = nullptr;     // the whole buffer, when persistent
+  uint8_t *regionData = nullptr; // the current frame's region while writable
+  GLsync fences[framesInFlight] = {};
+
+  void create(size_t frameSize) {
+    // whole uniform alignments so every region starts aligned
+    regionSize = (frameSize + uniformAlignment - 1) / uniformAlignment * uniformAlignment;
+    size_t total = regionSize * framesInFlight;
+    glGenBuffers(1, &id);
+    glBindBuffer(GL_ARRAY_BUFFER, id);
+    if (persistent) {
+      GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+      glBufferStorage(GL_ARRAY_BUFFER, total, NULL, flags);
+      mapped = static_cast<uint8_t*>(glMapBufferRange(GL_ARRAY_BUFFER, 0, total, flags));
+      if (!mapped) {
+        // the driver wouldn't map it after all, start over without
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        glDeleteBuffers(1, &id);
+        persistent = false;
+        create(frameSize);
+        return;
+      }
+    } else {
+      glBufferData(GL_ARRAY_BUFFER, total, NULL, GL_STREAM_DRAW);
+      mapped = nullptr;
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    regionData = nullptr;
+    // begin_frame() moves on to region 0 first
+    region = framesInFlight - 1;
+  }
+
+  static void wait(GLsync fence) {
+    if (!fence) return;
+    // flush once so the fence is sure to signal, then keep waiting
+    GLbitfield flags = GL_SYNC_FLUSH_COMMANDS_BIT;
+    while (glClientWaitSync(fence, flags, 1000000000) == GL_TIMEOUT_EXPIRED)
+      flags = 0;
+    glDeleteSync(fence);
+  }
+};
+
+#endif
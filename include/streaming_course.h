@@ -0,0 +1,148 @@
+#ifndef STREAMING_COURSE_H
+#define STREAMING_COURSE_H
+
+#include "aabb.h"
+#include "bvh.h"
+#include "course.h"
+#include "spatial_hash.h"
+#include "world.h"
+#include "glm/glm.hpp"
+
+#include <cstddef>
+#include <cstdint>
+
+// Endless course generated lazily in a fixed window of platform slots. The
+// checkpoint is the furthest platform the player has stood on, platforms
+// more than keepBehind behind it are retired and their slots refilled with
+// new ones ahead, so memory and work per advance() stay bounded however long
+// the run goes. Platform ids handed to the simulation are slot indices.
+class StreamingCourse : public World {
+public:
+  static const size_t capacity = 64;  // platforms alive at once
+  static const size_t keepBehind = 4; // kept behind the checkpoint
+  // falling below this many platforms past the checkpoint respawns, as far
+  // ahead as ReachabilityAnalyzer lets a single jump go
+  static const size_t respawnLookAhead = 16;
+  static_assert(keepBehind + respawnLookAhead < capacity, "respawn platform has to be alive");
+  // checkpoint distance from the origin that triggers a rebase, in world units
+  static constexpr float rebaseDistance = 512.0f;
+
+  glm::vec3 platformScale;
+  uint64_t checkpoints = 0; // times the checkpoint moved forward
+
+  StreamingCourse(uint64_t seed, const CourseParams &params, const glm::vec3 &playerSize)
+    : platformScale(params.platformScale), playerSize(playerSize),
+      generator(seed, params, true), hash(1.0f, capacity * 4) {
+    spawn = generator.spawn_platform()*platformScale + glm::vec3(0.0f, playerSize.y + 1.0f, 0.0f);
+    for (size_t slot = 0; slot < capacity; ++slot)
+      emit(slot);
+  }
+
+  // the simulation just stood on platform (a slot). Moves the checkpoint
+  // there if it's further along and streams the window forward. Returns true
+  // when any slot changed; if the origin was rebased, shift is what the
+  // player has to be moved by, otherwise it's zero.
+  bool advance(uint32_t platform, glm::vec3 &shift) {
+    shift = glm::vec3(0.0f);
+    if (platform >= capacity || (hasCheckpoint && sequence[platform] <= checkpoint))
+      return false;
+    hasCheckpoint = true;
+    checkpoint = sequence[platform];
+    ++checkpoints;
+    spawn = positions[platform]*platformScale + glm::vec3(0.0f, playerSize.y + 1.0f, 0.0f);
+
+    // the ring holds consecutive platforms, the oldest sits in next's slot
+    uint64_t first = checkpoint > keepBehind ? checkpoint - keepBehind : 0;
+    while (next < first + capacity)
+      emit(next % capacity);
+
+    glm::vec3 checkpointPos = positions[platform]*platformScale;
+    if (glm::length(checkpointPos) > rebaseDistance)
+      rebase(positions[platform], shift);
+    return true;
+  }
+
+  size_t size() const { return capacity; }
+  // platform in a slot, in platform units
+  const glm::vec3 &platform(size_t slot) const { return positions[slot]; }
+  // how many platforms came before the one in a slot
+  uint64_t platform_index(size_t slot) const { return sequence[slot]; }
+
+  glm::vec3 spawn_point() const override { return spawn; }
+  // below the lowest platform the player could still land on from the
+  // checkpoint, platforms only ever get lower so that's respawnLookAhead
+  // past it. The newest platform is a whole window further down
+  float respawn_height() const override {
+    uint64_t lowest = (hasCheckpoint ? checkpoint : 0) + respawnLookAhead;
+    return positions[lowest % capacity].y*platformScale.y - 0.5f;
+  }
+  bool is_finish(uint32_t) const override { return false; }
+
+  size_t overlap(const AABB &box, uint32_t *ids, AABB *boxes, size_t maxCount) const override {
+    size_t count = 0;
+    // platforms are hashed by their center
+    AABB query{box.min - platformScale/2.0f, box.max + platformScale/2.0f};
+    hash.query(query, [&](uint32_t slot) {
+      AABB platform = bounds(slot);
+      if (!aabb_overlap(platform, box)) return;
+      if (count < maxCount) {
+        ids[count] = slot;
+        boxes[count] = platform;
+      }
+      ++count;
+    });
+    return count;
+  }
+
+  bool sweep(const AABB &box, const glm::vec3 &delta, BVHHit &hit) const override {
+    glm::vec3 center = (box.min + box.max) * 0.5f;
+    glm::vec3 halfExtent = (box.max - box.min) * 0.5f;
+    AABB query{glm::min(box.min, box.min + delta) - platformScale/2.0f,
+               glm::max(box.max, box.max + delta) + platformScale/2.0f};
+    bool found = false;
+    float best = 1.0f;
+    hash.query(query, [&](uint32_t slot) {
+      found = sweep_candidate(center, delta, halfExtent, bounds(slot), slot, best, hit) || found;
+    });
+    return found;
+  }
+
+private:
+  glm::vec3 playerSize;
+  CourseGenerator generator;
+  SpatialHash hash;
+  glm::vec3 spawn;
+  glm::vec3 positions[capacity];
+  uint64_t sequence[capacity];
+  uint64_t next = 0; // index of the next platform to generate
+  uint64_t checkpoint = 0;
+  bool hasCheckpoint = false;
+
+  AABB bounds(size_t slot) const {
+    return aabb_from_center(positions[slot]*platformScale, platformScale/2.0f);
+  }
+
+  // generates the next platform into slot, retiring what was there
+  void emit(size_t slot) {
+    if (next >= capacity)
+      hash.remove(slot);
+    generator.next(positions[slot]);
+    sequence[slot] = next++;
+    hash.insert(slot, positions[slot]*platformScale);
+  }
+
+  // moves everything so origin (platform units) ends up at zero
+  void rebase(const glm::vec3 &origin, glm::vec3 &shift) {
+    glm::vec3 offset = origin;
+    generator.rebase(offset);
+    hash.clear();
+    for (size_t slot = 0; slot < capacity; ++slot) {
+      positions[slot] -= offset;
+      hash.insert(slot, positions[slot]*platformScale);
+    }
+    shift = -offset*platformScale;
+    spawn += shift;
+  }
+};
+
+#endif
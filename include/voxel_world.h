@@ -0,0 +1,206 @@
+#ifndef VOXEL_WORLD_H
+#define VOXEL_WORLD_H
+
+#include "aabb.h"
+#include "bvh.h"
+#include "world.h"
+#include "glm/glm.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+// Walls on a floor, from a grid file like include/map.txt: one line per row
+// along z, one character per cell along x, '1' is a wall and anything else is
+// open floor. Each wall cell is a cellSize square column wallHeight tall
+// standing on a single floor slab under the whole grid.
+//
+// Collision never looks at boxes: a query turns its bounds into a range of
+// cells and reads those straight out of the occupancy grid, so its cost only
+// depends on how many cells the player covers, not on the size of the map.
+// greedy_mesh() merges the walls into as few boxes as possible for drawing.
+class VoxelWorld : public World {
+public:
+  // set these before load()
+  float cellSize = 1.0f;
+  float wallHeight = 1.0f;
+  float floorThickness = 1.0f;
+
+  bool load(const std::filesystem::path &path) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file) return false;
+    std::string text((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    return parse(text);
+  }
+
+  // the same from the grid's text, e.g. an embedded asset
+  bool parse(const std::string &text) {
+    // first pass for the size, rows can be ragged
+    width = height = 0;
+    size_t column = 0;
+    for (char c : text) {
+      if (c == '\n') {
+        width = std::max(width, column);
+        column = 0;
+        ++height;
+      } else if (c != '\r') {
+        ++column;
+      }
+    }
+    if (column) {
+      width = std::max(width, column);
+      ++height;
+    }
+
+    cells.assign(width * height, 0);
+    size_t x = 0, z = 0;
+    for (char c : text) {
+      if (c == '\n') {
+        x = 0;
+        ++z;
+      } else if (c != '\r') {
+        cells[z * width + x++] = c == '1';
+      }
+    }
+    spawn = find_spawn();
+    return width && height;
+  }
+
+  size_t grid_width() const { return width; }
+  size_t grid_height() const { return height; }
+
+  bool solid(long x, long z) const {
+    if (x < 0 || z < 0 || x >= static_cast<long>(width) || z >= static_cast<long>(height)) return false;
+    return cells[z * width + x];
+  }
+
+  // id of the floor slab, walls are z * width + x of their cell
+  uint32_t floor_id() const { return static_cast<uint32_t>(width * height); }
+
+  AABB floor_box() const {
+    return AABB{glm::vec3(0.0f, -floorThickness, 0.0f),
+                glm::vec3(width * cellSize, 0.0f, height * cellSize)};
+  }
+
+  AABB cell_box(long x, long z) const {
+    return AABB{glm::vec3(x * cellSize, 0.0f, z * cellSize),
+                glm::vec3((x + 1) * cellSize, wallHeight, (z + 1) * cellSize)};
+  }
+
+  // the floor plus every wall merged into the largest rectangles that grow
+  // along x first, then z
+  std::vector<AABB> greedy_mesh() const {
+    std::vector<AABB> boxes;
+    boxes.push_back(floor_box());
+    std::vector<uint8_t> done(cells.size(), 0);
+    auto free_wall = [&](size_t x, size_t z) {
+      size_t i = z * width + x;
+      return cells[i] && !done[i];
+    };
+    for (size_t z = 0; z < height; ++z) {
+      for (size_t x = 0; x < width; ++x) {
+        if (!free_wall(x, z)) continue;
+        size_t runX = 1;
+        while (x + runX < width && free_wall(x + runX, z)) ++runX;
+        size_t runZ = 1;
+        for (; z + runZ < height; ++runZ) {
+          size_t i = 0;
+          while (i < runX && free_wall(x + i, z + runZ)) ++i;
+          if (i < runX) break;
+        }
+        for (size_t dz = 0; dz < runZ; ++dz)
+          std::fill_n(done.begin() + (z + dz) * width + x, runX, 1);
+        boxes.push_back(AABB{glm::vec3(x * cellSize, 0.0f, z * cellSize),
+                             glm::vec3((x + runX) * cellSize, wallHeight, (z + runZ) * cellSize)});
+        x += runX - 1;
+      }
+    }
+    return boxes;
+  }
+
+  glm::vec3 spawn_point() const override { return spawn; }
+
+  // off the edge of the floor
+  float respawn_height() const override { return -floorThickness - 5.0f; }
+  bool is_finish(uint32_t) const override { return false; }
+
+  size_t overlap(const AABB &box, uint32_t *ids, AABB *boxes, size_t capacity) const override {
+    size_t count = 0;
+    auto add = [&](uint32_t id, const AABB &b) {
+      if (count < capacity) {
+        ids[count] = id;
+        boxes[count] = b;
+      }
+      ++count;
+    };
+    AABB floor = floor_box();
+    if (aabb_overlap(floor, box)) add(floor_id(), floor);
+    for_cells(box, [&](long x, long z) {
+      AABB cell = cell_box(x, z);
+      if (aabb_overlap(cell, box)) add(static_cast<uint32_t>(z * width + x), cell);
+    });
+    return count;
+  }
+
+  bool sweep(const AABB &box, const glm::vec3 &delta, BVHHit &hit) const override {
+    glm::vec3 center = (box.min + box.max) * 0.5f;
+    glm::vec3 halfExtent = (box.max - box.min) * 0.5f;
+    bool found = false;
+    float best = 1.0f;
+    auto test = [&](uint32_t id, const AABB &b) {
+      found = sweep_candidate(center, delta, halfExtent, b, id, best, hit) || found;
+    };
+    test(floor_id(), floor_box());
+    // only the cells the box passes over can stop it
+    AABB swept{glm::min(box.min, box.min + delta), glm::max(box.max, box.max + delta)};
+    for_cells(swept, [&](long x, long z) {
+      test(static_cast<uint32_t>(z * width + x), cell_box(x, z));
+    });
+    return found;
+  }
+
+private:
+  size_t width = 0;
+  size_t height = 0;
+  std::vector<uint8_t> cells; // 1 for walls, row major along x
+  glm::vec3 spawn = glm::vec3(0.0f, 1.0f, 0.0f);
+
+  // the open cell closest to the middle of the map, searched in growing rings
+  glm::vec3 find_spawn() const {
+    long cx = width / 2, cz = height / 2;
+    long maxRadius = static_cast<long>(std::max(width, height));
+    for (long r = 0; r <= maxRadius; ++r) {
+      for (long z = cz - r; z <= cz + r; ++z) {
+        // the inside of the ring was searched already, only visit its edge
+        long step = z == cz - r || z == cz + r ? 1 : std::max(1L, 2 * r);
+        for (long x = cx - r; x <= cx + r; x += step) {
+          if (x >= 0 && z >= 0 && x < static_cast<long>(width) && z < static_cast<long>(height) && !solid(x, z))
+            return glm::vec3((x + 0.5f) * cellSize, 1.0f, (z + 0.5f) * cellSize);
+        }
+      }
+    }
+    return glm::vec3(0.0f, 1.0f, 0.0f);
+  }
+
+  // calls visit(x, z) for every wall cell box reaches into
+  template <typename Visit>
+  void for_cells(const AABB &box, Visit &&visit) const {
+    if (box.max.y < 0.0f || box.min.y > wallHeight || !width) return;
+    // overlap is inclusive, a box ending right on a cell edge touches it
+    long x0 = std::max(0L, static_cast<long>(std::ceil(box.min.x / cellSize)) - 1);
+    long z0 = std::max(0L, static_cast<long>(std::ceil(box.min.z / cellSize)) - 1);
+    long x1 = std::min(static_cast<long>(width) - 1, static_cast<long>(std::floor(box.max.x / cellSize)));
+    long z1 = std::min(static_cast<long>(height) - 1, static_cast<long>(std::floor(box.max.z / cellSize)));
+    for (long z = z0; z <= z1; ++z)
+      for (long x = x0; x <= x1; ++x)
+        if (cells[z * width + x]) visit(x, z);
+  }
+};
+
+#endif
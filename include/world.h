@@ -0,0 +1,33 @@
+#ifndef WORLD_H
+#define WORLD_H
+
+#include "aabb.h"
+#include "bvh.h"
+#include "glm/glm.hpp"
+
+#include <cstddef>
+#include <cstdint>
+
+// What the player simulation runs against: the platforms it collides with,
+// where it spawns and what counts as falling off or finishing. Queries write
+// into caller owned buffers so a tick never touches the heap.
+class World {
+public:
+  virtual ~World() = default;
+
+  // where respawn() puts the player
+  virtual glm::vec3 spawn_point() const = 0;
+  // the player respawns once its camera drops to this height
+  virtual float respawn_height() const = 0;
+  // standing on this platform ends the run
+  virtual bool is_finish(uint32_t platform) const = 0;
+
+  // writes up to capacity platforms overlapping box to ids/boxes and returns
+  // how many there are in total, which can be more than capacity
+  virtual size_t overlap(const AABB &box, uint32_t *ids, AABB *boxes, size_t capacity) const = 0;
+  // first platform entered while moving box by t*delta for t in [0, 1],
+  // platforms already overlapping box are skipped
+  virtual bool sweep(const AABB &box, const glm::vec3 &delta, BVHHit &hit) const = 0;
+};
+
+#endif
@@ -1,54 +1,50 @@
 #include "include/glad/glad.h"
 #include <GLFW/glfw3.h>
 #include "include/glm/fwd.hpp"
+#include "include/assets.h"
 #include "include/shader.h"
+#include "include/shader_manager.h"
+#include "include/stream_buffer.h"
+#include "include/frame_uniforms.h"
+#include "include/course.h"
+#include "include/reachability.h"
+#include "include/streaming_course.h"
+#include "include/voxel_world.h"
+#include "include/simulation.h"
+#include "include/demo.h"
+#include "include/frustum.h"
+#include "include/mesh.h"
 #include "include/glm/glm.hpp"
 #include "include/glm/gtc/matrix_transform.hpp"
 #include "include/glm/gtc/type_ptr.hpp"
 
 #include <cmath>
+#include <cstddef>
+#include <cstdlib>
+#include <ctime>
 #include <filesystem>
 #include <iostream>
 #include <random>
 #include <fstream>
 #include <iterator>
+#include <memory>
 #include <vector>
 
 #define GLFW_KEY_SPACE 32
 #define _USE_MATH_DEFINES
 
 GLFWwindow* init();
-void physics_update();
-std::vector<glm::vec3> player_collision();
-void player_movement(GLFWwindow *window, glm::vec3 wishDir);
-bool is_grounded();
 void framebuffer_size_callback(GLFWwindow* window, int width, int height);
-void process_input(GLFWwindow *window);
+TickInput process_input(GLFWwindow *window);
 void mouse_callback(GLFWwindow* window, double xpos, double ypos);
-void set_uniform_vec3(const Shader& shader, const GLchar* name, const glm::vec3& vec);
+void update_camera_front();
+std::filesystem::path shader_cache_dir();
 
 // settings
 const unsigned int SCR_WIDTH = 1600;
 const unsigned int SCR_HEIGHT = 1200;
 
-constexpr float g = 3.5f;
-const float friction = 0.7f;
-const float maxGroundSpeed = 10.0f;
-const float maxAirSpeed = 1.0f;
-const float acceleration = 5.0f;
-// const float airAcceleration = 0.1f;
-
-glm::vec3 playerVel;
-
-glm::vec3 playerSize = glm::vec3(0.65f, 0.6f, 0.65f);
-glm::vec3 platformScale = glm::vec3(0.4f, 0.1f, 0.4f);
-
-glm::vec3 spawn;
-float lowestPlatform;
-float totalTime;
-
 // camera init
-glm::vec3 cameraPos = glm::vec3(0.0f, playerSize.y, 0.0f);
 glm::vec3 cameraFront = glm::vec3(0.0f, 0.0f, -1.0f);
 glm::vec3 cameraUp = glm::vec3(0.0f, 1.0f, 0.0f);
 
@@ -62,143 +58,114 @@ bool firstMouse = true;
 float deltaTime = 0.0f;	// Time between current frame and last frame
 float lastFrame = 0.0f; // Time of last frame
 
-std::vector<glm::vec3> platformPositions;
-float cube[] = {
-  -1, -1, -1,  0.0f,  0.0f, -1.0f,
-  1, -1, -1,  0.0f,  0.0f, -1.0f,
-  1,  1, -1,  0.0f,  0.0f, -1.0f,
-  1,  1, -1,  0.0f,  0.0f, -1.0f,
-  -1,  1, -1,  0.0f,  0.0f, -1.0f,
-  -1, -1, -1,  0.0f,  0.0f, -1.0f,
-
-  -1, -1,  1,  0.0f,  0.0f,  1.0f,
-  1, -1,  1,  0.0f,  0.0f,  1.0f,
-  1,  1,  1,  0.0f,  0.0f,  1.0f,
-  1,  1,  1,  0.0f,  0.0f,  1.0f,
-  -1,  1,  1,  0.0f,  0.0f,  1.0f,
-  -1, -1,  1,  0.0f,  0.0f,  1.0f,
-
-  -1,  1,  1, -1.0f,  0.0f,  0.0f,
-  -1,  1, -1, -1.0f,  0.0f,  0.0f,
-  -1, -1, -1, -1.0f,  0.0f,  0.0f,
-  -1, -1, -1, -1.0f,  0.0f,  0.0f,
-  -1, -1,  1, -1.0f,  0.0f,  0.0f,
-  -1,  1,  1, -1.0f,  0.0f,  0.0f,
-
-  1,  1,  1,  1.0f,  0.0f,  0.0f,
-  1,  1, -1,  1.0f,  0.0f,  0.0f,
-  1, -1, -1,  1.0f,  0.0f,  0.0f,
-  1, -1, -1,  1.0f,  0.0f,  0.0f,
-  1, -1,  1,  1.0f,  0.0f,  0.0f,
-  1,  1,  1,  1.0f,  0.0f,  0.0f,
-
-  -1, -1, -1,  0.0f, -1.0f,  0.0f,
-  1, -1, -1,  0.0f, -1.0f,  0.0f,
-  1, -1,  1,  0.0f, -1.0f,  0.0f,
-  1, -1,  1,  0.0f, -1.0f,  0.0f,
-  -1, -1,  1,  0.0f, -1.0f,  0.0f,
-  -1, -1, -1,  0.0f, -1.0f,  0.0f,
-
-  -1,  1, -1,  0.0f,  1.0f,  0.0f,
-  1,  1, -1,  0.0f,  1.0f,  0.0f,
-  1,  1,  1,  0.0f,  1.0f,  0.0f,
-  1,  1,  1,  0.0f,  1.0f,  0.0f,
-  -1,  1,  1,  0.0f,  1.0f,  0.0f,
-  -1,  1, -1,  0.0f,  1.0f,  0.0f
+// simulation runs at a fixed tick rate (PhysicsParams::tickRate) decoupled
+// from the frame rate. Frames longer than this are clamped so a stall
+// doesn't queue up hundreds of ticks
+const float maxFrameTime = 0.25f;
+float accumulator = 0.0f;
+
+// seeds tried for a finishable course before giving up
+const int maxCourseRerolls = 1000;
+
+// what each drawn platform gets per instance. Models are only ever a
+// translation and an axis-aligned scale, so the normal matrix is just the
+// inverse scale, worked out here once instead of per vertex
+struct PlatformInstance {
+  glm::mat4 model;
+  glm::vec3 normalScale;
 };
 
+PlatformInstance platform_instance(const glm::mat4 &model, const glm::vec3 &scale) {
+  return PlatformInstance{model, 1.0f / scale};
+}
 
+int main(int argc, char **argv) {
+  // --replay <file> plays a demo back instead of taking input,
+  // --endless streams a course that never ends,
+  // --voxel [file] walks around a walled grid, include/map.txt by default
+  DemoReader replay;
+  bool replaying = argc == 3 && std::string(argv[1]) == "--replay";
+  bool endless = argc == 2 && std::string(argv[1]) == "--endless";
+  bool voxel = (argc == 2 || argc == 3) && std::string(argv[1]) == "--voxel";
+  if (replaying && !replay.load(argv[2])) {
+    std::cout << "Failed to load demo " << argv[2] << std::endl;
+    return -1;
+  }
 
-int main() {
   GLFWwindow* window = init();
   if (window == NULL) { return -1; }
 
   glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
-  glfwSetCursorPosCallback(window, mouse_callback);
-
-  std::filesystem::path resourcePath = std::filesystem::current_path().parent_path() / "src/include";
-  Shader shader(resourcePath / "vertex_shader.txt", resourcePath / "fragment_shader.txt");
+  if (!replaying)
+    glfwSetCursorPosCallback(window, mouse_callback);
+
+  // shaders are built into the game, see include/assets.h
+  std::string vertexCode, fragmentCode;
+  if (!load_asset("vertex_shader.txt", vertexCode) || !load_asset("fragment_shader.txt", fragmentCode)) {
+    std::cout << "Failed to load shaders" << std::endl;
+    return -1;
+  }
+  // programs compile while the course is built and the first frames run,
+  // linked ones are cached per user and reused while the sources and driver
+  // stay the same
+  ShaderManager shaders((GLADloadproc)glfwGetProcAddress);
+  Shader &shader = shaders.add(vertexCode, fragmentCode, shader_cache_dir());
+  // looked up once the program is ready, the render loop only sets them
+  Uniform<glm::vec3> objectColorUniform;
+  bool shaderSetUp = false;
+  // camera and light go to every program through one block written per frame
+  FrameUniforms frameUniforms;
+
+  VoxelWorld voxels;
+  if (voxel) {
+    std::string map;
+    bool loaded = argc == 3 ? voxels.load(argv[2]) : load_asset("map.txt", map) && voxels.parse(map);
+    if (!loaded) {
+      std::cout << "Failed to load voxel grid " << (argc == 3 ? argv[2] : "map.txt") << std::endl;
+      return -1;
+    }
+  }
 
   std::random_device rd; // Seed for random number generator
-  std::mt19937 gen(rd()); // Standard mersenne_twister_engine
-  std::uniform_real_distribution<float> rDis(5.0f, 20.0f);
-  std::uniform_real_distribution<float> thetaLengthDis(M_PI/2, 2*M_PI);
-
-  float dcInc = 1.0f;
-
-  float sumC = 0.0f;
-  float maxC = 300.0f;
-  float dc = 8.0f;
-  float r = rDis(gen);
-  float theta = 0.0f;
-  glm::vec3 pivot = glm::vec3(0.0f, 0.0f, 0.0f);
-  glm::vec3 pos;
-  float y = 1.0f;
-  int rot = 1;
-  float dtheta = dc/(2.0f*r);
-  spawn = (pivot + glm::vec3(r*cos(theta+rot*dtheta), y, r*sin(theta+rot*dtheta)))*platformScale + glm::vec3(0.0f, playerSize.y + 1.0f, 0.0f);
-  while (sumC + dc < maxC) {
-    float thetaLength = thetaLengthDis(gen);
-    float startTheta = theta;
-    for (theta += rot*dtheta; abs(startTheta - theta) <= thetaLength && sumC + dc <= maxC; theta += rot*dtheta) {
-      pos = pivot + glm::vec3(r*cos(theta), 0, r*sin(theta));
-      y -= 2.0f;
-      platformPositions.push_back(pos + glm::vec3(0.0f, y, 0.0f));
-      sumC += dc;
-      dc += dcInc;
-      dtheta = dc/(2.0f*r);
+  uint64_t seed = static_cast<uint64_t>(rd()) << 32 | rd();
+  CourseParams courseParams;
+  PhysicsParams physics;
+  if (replaying) {
+    seed = replay.info.seed;
+    courseParams = replay.info.course;
+    physics = replay.info.physics;
+  } else if (!endless && !voxel) {
+    // reroll courses that can't be finished, a few at most unless
+    // CourseParams rule out finishable courses altogether
+    ReachabilityAnalyzer reachability(physics, courseParams);
+    int rerolls = 0;
+    while (!reachability.analyze(seed)) {
+      if (++rerolls == maxCourseRerolls) {
+        std::cout << "No finishable course in " << maxCourseRerolls << " seeds, check CourseParams" << std::endl;
+        return -1;
+      }
+      seed = static_cast<uint64_t>(rd()) << 32 | rd();
     }
-
-    r = rDis(gen);
-
-    pivot = pos + r*glm::normalize(pos - pivot);
-    theta -= rot*((dc-dcInc)/(2.0f*r));
-    theta = theta < M_PI ? theta + M_PI : theta - M_PI;
-    rot = -rot;
   }
-
-  lowestPlatform = y*platformScale.y;
-  cameraPos = spawn;
-  // float dtheta =  PI/16.0f;
-
-  // const size_t object_size = 6;
-
-  // size_t row;
-  // size_t col;
-  // std::string buffer;
-  // std::ifstream map_file(resourcePath / "map.txt");
-
-  // while (std::getline(map_file, buffer)) {
-  //   for (col = 0; col < buffer.size() && buffer[col] != '\n'; ++col) {
-  //     if (buffer[col] == '1')
-  //       voxelPositions.push_back(glm::vec3(col * 2, voxelScale.y / 2.0f, row * 2));
-  //   }
-  //   ++row;
-  // }
-
-  // cameraPos = glm::vec3(col*voxelScale.x, 1, row*voxelScale.z);
-  // lightPos = glm::vec3(col*voxelScale.x, 1, row*voxelScale.z);
-
-
-
-  // float vertices[vertex_vec.size()];
-  // copy(vertex_vec.begin(), vertex_vec.end(), vertices);
-
-  // unsigned int indices[] = {
-  //   0, 1, 3,   // first triangle
-  //   1, 2, 3,    // second triangle
-  //   0+4, 1+4, 3+4,   // first triangle
-  //   1+4, 2+4, 3+4,    // second triangle
-  //   0+4*2, 1+4*2, 3+4*2,   // first triangle
-  //   1+4*2, 2+4*2, 3+4*2,    // second triangle
-  //   0+4*3, 1+4*3, 3+4*3,   // first triangle
-  //   1+4*3, 2+4*3, 3+4*3,    // second triangle
-  // };
-
-
-  unsigned int VBO, VAO/*, EBO*/;
+  std::unique_ptr<Course> course;
+  std::unique_ptr<StreamingCourse> stream;
+  if (endless)
+    stream = std::make_unique<StreamingCourse>(seed, courseParams, physics.playerSize);
+  else if (!voxel)
+    course = std::make_unique<Course>(generate_course(seed, courseParams, physics.playerSize));
+  const World &world = voxel ? static_cast<const World&>(voxels)
+    : endless ? static_cast<const World&>(*stream) : *course;
+  Simulation sim(world, physics);
+  // every run is recorded from spawn, finished runs are saved to demos/
+  DemoWriter demo(seed, courseParams, physics);
+  std::filesystem::path demoPath = std::filesystem::current_path() / "demos";
+
+  // 24 packed vertices and 36 indices, see include/mesh.h
+  Mesh cube = cube_mesh();
+
+  unsigned int VBO, VAO, EBO;
   glGenBuffers(1, &VBO);
-  // glGenBuffers(1, &EBO);
+  glGenBuffers(1, &EBO);
   glGenVertexArrays(1, &VAO);
 
   // bind Vertex Array Object
@@ -206,34 +173,64 @@ int main() {
 
   // bopy vertices array in buffer for OpenGL to use
   glBindBuffer(GL_ARRAY_BUFFER, VBO); 
-  glBufferData(GL_ARRAY_BUFFER, sizeof(cube), cube, GL_STATIC_DRAW);
-
-  // bopy indices into buffer
-  // glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-  // glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices, GL_STATIC_DRAW);
-
-  // set the vertex attributes pointers
-
-  // how to interpret vertex data buffer
-  //
-  // using 0 in 1st param because that 
-  // is where I set the location of the position attribute
-  //
-  // position: vec3
-  // position values: floats, not normalized
-  // start: 0
-  //
-  // position attribute
-  glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)0);
-  glEnableVertexAttribArray(0);
-  // normal attribute
-  glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)(3 * sizeof(float)));
-  glEnableVertexAttribArray(1);
-
-  // note that this is allowed, the call to glVertexAttribPointer 
-  // registered VBO as the vertex attribute's bound vertex buffer 
-  // object so afterwards we can safely unbind
-  glBindBuffer(GL_ARRAY_BUFFER, 0);
+  glBufferData(GL_ARRAY_BUFFER, cube.vertices.size() * sizeof(MeshVertex), cube.vertices.data(), GL_STATIC_DRAW);
+
+  // bopy indices into buffer, the VAO remembers the binding
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+  glBufferData(GL_ELEMENT_ARRAY_BUFFER, cube.indices.size() * sizeof(uint16_t), cube.indices.data(), GL_STATIC_DRAW);
+
+  // position and normal attributes
+  mesh_vertex_attributes();
+
+  // model matrices and drawn bounds of every platform, an endless course
+  // rewrites its fixed number of slots whenever the window moves. A voxel
+  // grid draws the boxes greedy meshing merged its walls into, the cube
+  // spans -1 to 1 so each is scaled by its half extent
+  std::vector<AABB> voxelBoxes = voxel ? voxels.greedy_mesh() : std::vector<AABB>();
+  size_t platformCount = voxel ? voxelBoxes.size() : endless ? stream->size() : course->platformPositions.size();
+  std::vector<PlatformInstance> platformInstances(platformCount);
+  std::vector<AABB> platformBounds(platformCount);
+  FrustumCuller culler;
+  auto update_platform_instances = [&]() {
+    for (size_t i = 0; i < platformCount; ++i) {
+      if (voxel) {
+        const AABB &box = voxelBoxes[i];
+        glm::vec3 halfExtent = (box.max - box.min) / 2.0f;
+        glm::mat4 model = glm::scale(glm::translate(glm::mat4(1.0f), (box.min + box.max) / 2.0f), halfExtent);
+        platformInstances[i] = platform_instance(model, halfExtent);
+        platformBounds[i] = box;
+        continue;
+      }
+      glm::vec3 scale = endless ? stream->platformScale : course->platformScale;
+      glm::vec3 pos = endless ? stream->platform(i) : course->platformPositions[i];
+      platformInstances[i] = platform_instance(glm::translate(glm::scale(glm::mat4(1.0f), scale), pos), scale);
+      platformBounds[i] = aabb_from_center(pos * scale, scale);
+    }
+    culler.set_boxes(platformBounds.data(), platformCount);
+  };
+  update_platform_instances();
+  // only the platforms that survive culling are written each frame, along
+  // with the frame's uniforms, into a ring buffer the GPU reads from while
+  // the next frames are written, see include/stream_buffer.h
+  std::vector<uint32_t> visible;
+  visible.reserve(platformCount);
+  size_t streamFrameSize = std::min<size_t>(platformCount, 4096) * sizeof(PlatformInstance) + sizeof(FrameData);
+  // with room to align both, 256 is the most any driver asks uniforms for
+  StreamBuffer streamBuffer(streamFrameSize + 2 * 256);
+
+  // model attribute, a mat4 takes up 4 consecutive vec4 locations
+  // and advances once per instance instead of once per vertex, then the
+  // normal scale attribute, also per instance. Where they start in the ring
+  // changes every frame, so the pointers are set again before each draw
+  auto instance_attributes = [&](GLintptr offset) {
+    for (unsigned int i = 0; i < 4; ++i)
+      glVertexAttribPointer(2 + i, 4, GL_FLOAT, GL_FALSE, sizeof(PlatformInstance), (void*)(offset + i * sizeof(glm::vec4)));
+    glVertexAttribPointer(6, 3, GL_FLOAT, GL_FALSE, sizeof(PlatformInstance), (void*)(offset + offsetof(PlatformInstance, normalScale)));
+  };
+  for (unsigned int i = 2; i <= 6; ++i) {
+    glEnableVertexAttribArray(i);
+    glVertexAttribDivisor(i, 1);
+  }
 
   // you can unbind the VAO afterwards so other VAO calls 
   // won't accidentally modify this VAO, but this rarely happens
@@ -242,30 +239,63 @@ int main() {
   // generally don't unbind VAOs (nor VBOs) when it's not necessary
   glBindVertexArray(0);
 
+  float lastTitleTime = 0.0f;
+
   // render loop
   while(!glfwWindowShouldClose(window)) {
     float currentFrame = glfwGetTime();
     deltaTime = currentFrame - lastFrame;
     lastFrame = currentFrame;
-    totalTime += deltaTime;
 
-    // input
-    process_input(window);
-    physics_update();
+    // run as many fixed ticks as the elapsed time covers
+    accumulator += std::min(deltaTime, maxFrameTime);
+    bool platformsMoved = false;
+    while (accumulator >= sim.tickTime) {
+      // input
+      TickInput input = process_input(window);
+      if (replaying) {
+        if (!replay.next(input)) {
+          glfwSetWindowShouldClose(window, true);
+          break;
+        }
+        yaw = input.yaw;
+        pitch = input.pitch;
+        update_camera_front();
+      }
+      quantize_angles(input);
+      // endless and voxel runs never finish, so there'd be nothing to save
+      if (!endless && !voxel)
+        demo.record(input);
+
+      TickEvent event = sim.tick(input);
+      glm::vec3 shift;
+      if (endless && stream->advance(sim.lastPlatform, shift)) {
+        sim.shift_origin(shift);
+        platformsMoved = true;
+      }
+      if (event == TickEvent::Finish) {
+        std::cout << "Time: " << sim.finishTime << " seconds" << std::endl;
+        if (!replaying) {
+          std::filesystem::create_directories(demoPath);
+          std::filesystem::path file = demoPath / ("run-" + std::to_string(std::time(nullptr)) + "-" + std::to_string(seed) + ".demo");
+          if (!demo.save(file))
+            std::cout << "Failed to save demo " << file << std::endl;
+        }
+      }
+      if (event != TickEvent::None)
+        demo.reset();
+      accumulator -= sim.tickTime;
+    }
+    if (platformsMoved)
+      update_platform_instances();
+    // how far we are between the last tick and the next one
+    glm::vec3 renderPos = glm::mix(sim.prevCameraPos, sim.cameraPos, accumulator / sim.tickTime);
 
     // rendering commands
     glClearColor(0.2f, 0.3f, 0.3f, 1.0f);
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-    // activate shader
-    shader.use();
-
-    glm::vec3 objectColor = glm::vec3(1.0f, 0.5f, 0.31f);
-    set_uniform_vec3(shader, "objectColor", objectColor);
     glm::vec3 lightColor = glm::vec3(1.0f, 1.0f, 1.0f);
-    set_uniform_vec3(shader, "lightColor", lightColor);
-    set_uniform_vec3(shader, "lightPos", lightPos);
-    set_uniform_vec3(shader, "viewPos", cameraPos);
 
     // actually pointing in the reverse direction that we want
     // glm::vec3 cameraDirection = glm::normalize(cameraPos - cameraTarget);
@@ -274,39 +304,63 @@ int main() {
     // glm::vec3 cameraRight = glm::normalize(glm::cross(up, cameraDirection));
     // glm::vec3 cameraUp = glm::cross(cameraDirection, cameraRight);
 
-    int modelLoc = glGetUniformLocation(shader.ID, "model");
-    int viewLoc = glGetUniformLocation(shader.ID, "view");
-    int projectionLoc = glGetUniformLocation(shader.ID, "projection");
-    glm::mat4 model = glm::mat4(1.0f);
     glm::mat4 view;
     glm::mat4 projection;
-    // model = glm::rotate(model, (float)glfwGetTime() * glm::radians(50.0f), glm::vec3(0.5f, 1.0f, 0.0f));
     // note that we're translating the scene in the reverse direction of where we want to move
-    view = glm::lookAt(cameraPos, cameraPos + cameraFront, cameraUp);
+    view = glm::lookAt(renderPos, renderPos + cameraFront, cameraUp);
     projection = glm::perspective(glm::radians(fov), 800.0f / 600.0f, 0.1f, 100.0f);
-    glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(model));
-    glUniformMatrix4fv(viewLoc, 1, GL_FALSE, glm::value_ptr(view));
-    glUniformMatrix4fv(projectionLoc, 1, GL_FALSE, glm::value_ptr(projection));
-
-    glBindVertexArray(VAO);
-    for (auto &pos : platformPositions)
-    {
-      // calculate the model matrix for each object and pass it to shader before drawing
-
-      glm::mat4 model = glm::scale(glm::mat4(1.0f), platformScale); 
-      model = glm::translate(model, pos);
-      glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(model));
-
-      glDrawArrays(GL_TRIANGLES, 0, 36);
+    FrameData frame;
+    frame.view = view;
+    frame.projection = projection;
+    frame.viewPos = glm::vec4(renderPos, 1.0f);
+    frame.lightPos = glm::vec4(lightPos, 1.0f);
+    frame.lightColor = glm::vec4(lightColor, 1.0f);
+
+    size_t visibleCount = culler.cull(frustum_from_matrix(projection * view), visible);
+    // grows the ring when more is visible than it has room for
+    streamBuffer.reserve(visibleCount * sizeof(PlatformInstance) + sizeof(FrameData) + 2 * streamBuffer.uniform_alignment());
+    streamBuffer.begin_frame();
+    frameUniforms.update(streamBuffer, frame);
+    // visible instances go straight into the mapped buffer
+    GLintptr instanceOffset = 0;
+    PlatformInstance *instances = static_cast<PlatformInstance*>(
+      streamBuffer.allocate(visibleCount * sizeof(PlatformInstance), alignof(PlatformInstance), instanceOffset));
+    if (!instances)
+      visibleCount = 0;
+    for (size_t i = 0; i < visibleCount; ++i)
+      instances[i] = platformInstances[visible[i]];
+    streamBuffer.end_writes();
+
+    // frames before the program has finished compiling are only cleared
+    if (shader.ready()) {
+      if (!shaderSetUp) {
+        objectColorUniform = shader.uniform<glm::vec3>("objectColor");
+        frameUniforms.attach(shader);
+        shaderSetUp = true;
+      }
+      // activate shader
+      shader.use();
+
+      glm::vec3 objectColor = glm::vec3(1.0f, 0.5f, 0.31f);
+      shader.set(objectColorUniform, objectColor);
+
+      // every visible platform in one call, model matrices come from the
+      // instances written above
+      glBindVertexArray(VAO);
+      glBindBuffer(GL_ARRAY_BUFFER, streamBuffer.buffer());
+      instance_attributes(instanceOffset);
+      glBindBuffer(GL_ARRAY_BUFFER, 0);
+      glDrawElementsInstanced(GL_TRIANGLES, cube.indices.size(), GL_UNSIGNED_SHORT, 0, visibleCount);
+    }
+    streamBuffer.end_frame();
+
+    // culling stats in the title, refreshed once a second
+    if (currentFrame - lastTitleTime >= 1.0f) {
+      lastTitleTime = currentFrame;
+      std::string title = "GameEngine - " + std::to_string(visibleCount) + " visible, "
+        + std::to_string(platformCount - visibleCount) + " culled";
+      glfwSetWindowTitle(window, title.c_str());
     }
-
-    // render shape
-    // glBindVertexArray(VAO);
-    // glDrawArrays(GL_TRIANGLES, 0, 3);
-    // glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-    // glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
-    // glDrawArrays(GL_TRIANGLES, 0, 36);
-
 
     // swaps color buffer for each pixel in GLFW window
     glfwSwapBuffers(window);
@@ -317,6 +371,8 @@ int main() {
   // de-allocate all resources once they've outlived their purpose
   glDeleteVertexArrays(1, &VAO);
   glDeleteBuffers(1, &VBO);
+  glDeleteBuffers(1, &EBO);
+  streamBuffer.destroy();
   // glDeleteProgram(shaderProgram);
 
   // cleans/deletes all of GLFW's resources
@@ -371,175 +427,20 @@ void framebuffer_size_callback(GLFWwindow* window, int width, int height) {
   glViewport(0, 0, width, height);
 }  
 
-bool is_grounded() {
-  for (const auto& col : player_collision()) {
-    if (glm::all(glm::equal(col, glm::vec3(0.0f, 1.0f, 0.0f)))) return true;
-  }
-  return false;
-  // return cameraPos.y - playerSize.y < 0.01f;
-}
-
-void physics_update() {
-  if (!is_grounded())
-    playerVel.y -= g * deltaTime;
-  else
-    playerVel.y = std::max(playerVel.y, 0.0f);
-  cameraPos += playerVel * deltaTime;
-  if (cameraPos.y <= lowestPlatform - 0.5f) {
-    totalTime = 0.0f;
-    playerVel = glm::vec3(0.0f, 0.0f, 0.0f);
-    cameraPos = spawn;
-  }
-  if (cameraPos.y <= lowestPlatform + platformScale.y/2.0f + playerSize.y && is_grounded()) {
-    std::cout << "Time: " << totalTime << " seconds" << std::endl;
-    totalTime = 0.0f;
-    playerVel = glm::vec3(0.0f, 0.0f, 0.0f);
-    cameraPos = spawn;
-  }
-}
-
-std::vector<glm::vec3> player_collision() {
-  std::vector<glm::vec3> collisions;
-  // TODO: make voxelPositions a hashmap for positions
-  // TODO: get bound of players, subtract them with the points on the bound of platform, then find the vector that orthogonal to the normal
-  for (auto platform : platformPositions) {
-    platform *= platformScale;
-    float xMinPlat = platform.x - platformScale.x/2.0f;
-    float xMaxPlat = platform.x + platformScale.x/2.0f;
-    float yMinPlat = platform.y - platformScale.y/2.0f;
-    float yMaxPlat = platform.y + platformScale.y/2.0f;
-    float zMinPlat = platform.z - platformScale.z/2.0f;
-    float zMaxPlat = platform.z + platformScale.z/2.0f;
-
-    float xMinPlayer = cameraPos.x - playerSize.x/2.0f;
-    float xMaxPlayer = cameraPos.x + playerSize.x/2.0f;
-    float yMinPlayer = cameraPos.y - playerSize.y;
-    float yMaxPlayer = cameraPos.y;
-    float zMinPlayer = cameraPos.z - playerSize.z/2.0f;
-    float zMaxPlayer = cameraPos.z + playerSize.z/2.0f;
-
-    if (xMinPlayer <= xMaxPlat && xMaxPlayer >= xMinPlat 
-      && yMinPlayer <= yMaxPlat && yMaxPlayer >= yMinPlat 
-      && zMinPlayer <= zMaxPlat && zMaxPlayer >= zMinPlat) {
-
-      const float error = 0.05f;
-
-      if (abs(xMinPlat - xMaxPlayer) < error)
-        collisions.push_back(glm::vec3(-1.0f, 0.0f, 0.0f));
-      else if (abs(xMaxPlat - xMinPlayer) < error)
-        collisions.push_back(glm::vec3(1.0f, 0.0f, 0.0f));
-      else if (abs(yMinPlat - yMaxPlayer) < error)
-        collisions.push_back(glm::vec3(0.0f, -1.0f, 0.0f));
-      else if (abs(yMaxPlat - yMinPlayer) < error)
-        collisions.push_back(glm::vec3(0.0f, 1.0f, 0.0f));
-      else if (abs(zMinPlat - zMaxPlayer) < error)
-        collisions.push_back(glm::vec3(0.0f, 0.0f, -1.0f));
-      else if (abs(zMaxPlat - zMinPlayer) < error)
-        collisions.push_back(glm::vec3(0.0f, 0.0f, 1.0f));
-      else
-        collisions.push_back(glm::vec3(0.0f, 1.0f, 0.0f));
-
-      // float maxIntersect = 0;
-      // glm::vec3 bestNormal;
-      // if (std::min(voxel.x + voxelScale.x/2.0f - cameraPos.x - playerSize.x/2.0f,
-      //              cameraPos.x + playerSize.x/2.0f - voxel.x - voxelScale.x/2.0f) <
-      //     std::min(voxel.z + voxelScale.z/2.0f - cameraPos.z - playerSize.z/2.0f,
-      //              cameraPos.z + playerSize.z/2.0f - voxel.z - voxelScale.z/2.0f))
-      //   collisions.push_back(glm::dot(cameraPos - voxel, glm::vec3(1, 0, 0)) >= 0 ? glm::vec3(1, 0, 0) : glm::vec3(-1, 0, 0));
-      // else
-      //   collisions.push_back(glm::dot(cameraPos - voxel, glm::vec3(0, 0, 1)) >= 0 ? glm::vec3(0, 0, 1) : glm::vec3(0, 0, -1));
-       // if (voxel.x + voxelScale.x/2.0f - cameraPos.x - playerSize.z/2.0f < voxel.z + voxelScale.z/2.0f - cameraPos.z - playerSize.z/2.0f)
-       //   collisions.push_back(glm::vec3(1, 0, 0));
-       // else if (voxel.x - voxelScale.x/2.0f - cameraPos.x + playerSize.z/2.0f < voxel.z - voxelScale.z/2.0f - cameraPos.z + playerSize.z/2.0f)
-       //   collisions.push_back(glm::vec3(-1, 0, 0));
-       // else if (voxel.z + voxelScale.z/2.0f - cameraPos.z - playerSize.z/2.0f < voxel.z + voxelScale.z/2.0f - cameraPos.z - playerSize.z/2.0f)
-       //   collisions.push_back(glm::dot(cameraPos - voxel, glm::vec3(0, 0, 1)) >= 0 ? glm::vec3(0, 0, 1) : glm::vec3(0, 0, -1));
-
-      // if (cameraPos.x - playerSize.x/2.0f == platform.x + platformScale.x/2.0f)
-      //   collisions.push_back(glm::vec3(1.0f, 0.0f, 0.0f));
-      // else if (cameraPos.x + playerSize.x/2.0f == platform.x - platformScale.x/2.0f)
-      //   collisions.push_back(glm::vec3(-1.0f, 0.0f, 0.0f));
-      // else if (cameraPos.y - playerSize.y == platform.y + platformScale.y/2.0f)
-      //   collisions.push_back(glm::vec3(0.0f, 1.0f, 0.0f));
-      // else if (cameraPos.y == platform.y - platformScale.y/2.0f)
-      //   collisions.push_back(glm::vec3(0.0f, -1.0f, 0.0f));
-      // else if (cameraPos.z - playerSize.z/2.0f == platform.z + platformScale.z/2.0f)
-      //   collisions.push_back(glm::vec3(0.0f, 0.0f, -1.0f));
-      // else if (cameraPos.z + playerSize.z/2.0f == platform.z - platformScale.z/2.0f)
-      //   collisions.push_back(glm::vec3(0.0f, 0.0f, -1.0f));
-      // glm::vec3 intersection = cameraPos - glm::vec3(0.0f, playerSize.y, 0.0f) - platform;
-      // glm::vec3 bestNormal = glm::vec3(0, 0, 0);
-      // std::vector<glm::vec3> normals = { glm::vec3(1, 0, 0), glm::vec3(-1, 0, 0), glm::vec3(0, 1, 0), 
-      //   glm::vec3(0, -1, 0), glm::vec3(0, 0, 1), glm::vec3(0, 0, -1) };
-      // for (auto& normal : normals) {
-      //   // glm::vec3 target = voxel / platformScale + normal * 2.0f;
-      //   if (glm::dot(intersection, normal) > glm::dot(intersection, bestNormal))
-      //     // && std::all_of(platformPositions.begin(), platformPositions.end(), [target](const glm::vec3 &v) 
-      //                    // { return glm::distance(v, target) > 0.01f; }))
-      //     bestNormal = normal;
-      // }
-      // collisions.push_back(bestNormal);
-    }
-  } 
-  return collisions;
-}
-
-void process_input(GLFWwindow *window) {
+// samples the keyboard once per tick, movement itself happens in Simulation
+TickInput process_input(GLFWwindow *window) {
   if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS)
     glfwSetWindowShouldClose(window, true);
 
-  const float jumpForce = 1.3f;
-  if (glfwGetKey(window, GLFW_KEY_SPACE) == GLFW_PRESS && is_grounded())
-    playerVel.y = jumpForce;
-
-  const float cameraSpeed = 0.8f * deltaTime; // adjust accordingly
-
-  glm::vec3 wishDir = glm::vec3(0.0f, 0.0f, 0.0f);
-  glm::vec3 dir = glm::normalize(glm::vec3(cameraFront.x, 0.0f, cameraFront.z));
-  if (glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS)
-    wishDir += dir;
-  if (glfwGetKey(window, GLFW_KEY_S) == GLFW_PRESS)
-    wishDir += -dir;
-  if (glfwGetKey(window, GLFW_KEY_A) == GLFW_PRESS)
-    wishDir += -glm::normalize(glm::cross(dir, cameraUp));
-  if (glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS)
-    wishDir += glm::normalize(glm::cross(dir, cameraUp));
-  if (wishDir != glm::vec3(0.0f, 0.0f, 0.0f))
-    wishDir = glm::normalize(wishDir);
-
-  player_movement(window, wishDir);
-  // cameraPos += wishdir * cameraSpeed;
-}
-
-void player_movement(GLFWwindow *window, glm::vec3 wishDir) {
-  if (is_grounded() && glfwGetKey(window, GLFW_KEY_SPACE) != GLFW_PRESS) {
-    playerVel.x *= friction;
-    playerVel.z *= friction;
-
-    float maxAccel = maxGroundSpeed * acceleration;
-
-    float currentSpeed = glm::dot(glm::vec3(playerVel.x, 0, playerVel.z), wishDir);
-    float addSpeed = maxGroundSpeed - currentSpeed > maxAccel * deltaTime ? maxAccel * deltaTime 
-      : (maxGroundSpeed - currentSpeed < 0 ? 0 : maxGroundSpeed - currentSpeed);
-    playerVel += addSpeed * wishDir;
-  } else {
-    float maxAccel = maxGroundSpeed * acceleration;
-    float currentSpeed = glm::dot(glm::vec3(playerVel.x, 0, playerVel.z), wishDir);
-    // clamps value
-    float addSpeed = maxAirSpeed - currentSpeed > maxAccel * deltaTime ? maxAccel * deltaTime 
-      : (maxAirSpeed - currentSpeed < 0 ? 0 : maxAirSpeed - currentSpeed);
-    playerVel += addSpeed * wishDir;
-    playerVel.x *= std::pow(0.99f, std::pow(glm::length(playerVel)/20.0f, 1.1f));
-    playerVel.z *= std::pow(0.99f, std::pow(glm::length(playerVel)/20.0f, 1.1f));
-  }
-
-  std::vector<glm::vec3> collisions = player_collision();
-  for (auto& normal : collisions) {
-    // glm::vec3 u = glm::normalize(glm::vec3(col.x - cameraPos.x, 0.0f, col.z - cameraPos.z));
-    glm::vec3 u = -normal;
-    if (glm::dot(playerVel, u) > 0)
-      playerVel -= glm::dot(playerVel, u)*u;
-  }
+  TickInput input;
+  input.forward = glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS;
+  input.back = glfwGetKey(window, GLFW_KEY_S) == GLFW_PRESS;
+  input.left = glfwGetKey(window, GLFW_KEY_A) == GLFW_PRESS;
+  input.right = glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS;
+  input.jump = glfwGetKey(window, GLFW_KEY_SPACE) == GLFW_PRESS;
+  input.yaw = yaw;
+  input.pitch = pitch;
+  return input;
 }
 
 void mouse_callback(GLFWwindow* window, double xpos, double ypos) {
@@ -567,6 +468,10 @@ void mouse_callback(GLFWwindow* window, double xpos, double ypos) {
   if(pitch < -89.0f)
     pitch = -89.0f;
 
+  update_camera_front();
+}
+
+void update_camera_front() {
   glm::vec3 direction;
   direction.x = cos(glm::radians(yaw)) * cos(glm::radians(pitch));
   direction.y = sin(glm::radians(pitch));
@@ -574,7 +479,26 @@ void mouse_callback(GLFWwindow* window, double xpos, double ypos) {
   cameraFront = glm::normalize(direction);
 }
 
-void set_uniform_vec3(const Shader& shader, const GLchar* name, const glm::vec3& vec) {
-  int loc = glGetUniformLocation(shader.ID, name);
-  glUniform3f(loc, vec.x, vec.y, vec.z);
+// the user's cache directory, so the cache doesn't depend on where the game
+// is run from. Empty, which turns caching off, when there's none to find
+std::filesystem::path shader_cache_dir() {
+  std::filesystem::path base;
+  const char *xdg = std::getenv("XDG_CACHE_HOME");
+  const char *localAppData = std::getenv("LOCALAPPDATA");
+  const char *home = std::getenv("HOME");
+  // relative XDG paths are meant to be ignored
+  if (xdg && std::filesystem::path(xdg).is_absolute())
+    base = xdg;
+  else if (localAppData && *localAppData)
+    base = localAppData;
+#ifdef __APPLE__
+  else if (home && *home)
+    base = std::filesystem::path(home) / "Library" / "Caches";
+#else
+  else if (home && *home)
+    base = std::filesystem::path(home) / ".cache";
+#endif
+  if (base.empty())
+    return base;
+  return base / "game-engine" / "shaders";
 }
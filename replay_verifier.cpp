@@ -0,0 +1,140 @@
+// Re-simulates every demo in a directory on all cores and reports which runs
+// reach the finish and in how many ticks. No window or GL involved.
+//
+// Demos come from players, so nothing in them is trusted: runs recorded with
+// anything but the game's own course and physics parameters are rejected
+// before simulating, as are runs that respawn on the way, since the game
+// restarts its recording on every respawn.
+//
+// usage: ReplayVerifier [-j threads] <demo directory>
+
+#include "include/course.h"
+#include "include/demo.h"
+#include "include/simulation.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <filesystem>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+struct VerifyResult {
+  bool loaded = false;
+  bool defaultParams = false; // recorded with the game's CourseParams and PhysicsParams
+  uint64_t respawnTick = 0;   // first tick the player fell and respawned on, 0 if never
+  bool finished = false;
+  uint64_t finishTick = 0; // ticks from spawn up to and including the finish
+  uint64_t ticks = 0;      // ticks in the demo
+  float finishTime = 0.0f;
+};
+
+// a demo has to have been recorded with exactly what the game uses
+bool default_params(const DemoInfo &info) {
+  return same_course_params(info.course, CourseParams()) && same_physics_params(info.physics, PhysicsParams());
+}
+
+VerifyResult verify(const std::filesystem::path &path) {
+  VerifyResult result;
+  DemoReader demo;
+  if (!demo.load(path)) return result;
+  result.loaded = true;
+  result.ticks = demo.info.ticks;
+  result.defaultParams = default_params(demo.info);
+  if (!result.defaultParams) return result;
+
+  Course course = generate_course(demo.info.seed, demo.info.course, demo.info.physics.playerSize);
+  Simulation sim(course, demo.info.physics);
+
+  TickInput input;
+  for (uint64_t tick = 1; demo.next(input); ++tick) {
+    TickEvent event = sim.tick(input);
+    if (event == TickEvent::Respawn) {
+      result.respawnTick = tick;
+      break;
+    }
+    if (event == TickEvent::Finish) {
+      result.finished = true;
+      result.finishTick = tick;
+      result.finishTime = sim.finishTime;
+      break;
+    }
+  }
+  return result;
+}
+
+int main(int argc, char **argv) {
+  unsigned threads = std::max(1u, std::thread::hardware_concurrency());
+  const char *dir = nullptr;
+  for (int i = 1; i < argc; ++i) {
+    std::string arg = argv[i];
+    if (arg == "-j" && i + 1 < argc)
+      threads = std::max(1, std::atoi(argv[++i]));
+    else if (arg[0] != '-')
+      dir = argv[i];
+  }
+  if (!dir) {
+    std::cout << "usage: " << argv[0] << " [-j threads] <demo directory>" << std::endl;
+    return 1;
+  }
+
+  std::vector<std::filesystem::path> demos;
+  std::error_code error;
+  for (const auto &entry : std::filesystem::directory_iterator(dir, error))
+    if (entry.is_regular_file() && entry.path().extension() == ".demo")
+      demos.push_back(entry.path());
+  if (error) {
+    std::cout << "failed to read " << dir << ": " << error.message() << std::endl;
+    return 1;
+  }
+  std::sort(demos.begin(), demos.end());
+
+  // workers pull the next demo off a shared counter, so long and short runs
+  // balance out without any per-thread queues
+  std::vector<VerifyResult> results(demos.size());
+  std::atomic<size_t> next(0);
+  auto start = std::chrono::steady_clock::now();
+  std::vector<std::thread> pool;
+  threads = std::min<size_t>(threads, std::max<size_t>(demos.size(), 1));
+  for (unsigned t = 0; t < threads; ++t) {
+    pool.emplace_back([&]() {
+      for (size_t i = next++; i < demos.size(); i = next++)
+        results[i] = verify(demos[i]);
+    });
+  }
+  for (auto &thread : pool) thread.join();
+  double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+  size_t finished = 0, broken = 0, rejected = 0;
+  uint64_t ticks = 0;
+  for (size_t i = 0; i < demos.size(); ++i) {
+    const VerifyResult &r = results[i];
+    std::cout << demos[i].filename().string() << ": ";
+    ticks += r.ticks;
+    if (!r.loaded) {
+      ++broken;
+      std::cout << "unreadable" << std::endl;
+    } else if (!r.defaultParams) {
+      ++rejected;
+      std::cout << "rejected, recorded with non-default course or physics parameters" << std::endl;
+    } else if (r.respawnTick) {
+      ++rejected;
+      std::cout << "rejected, respawned at tick " << r.respawnTick << std::endl;
+    } else if (r.finished) {
+      ++finished;
+      std::cout << "finished in " << r.finishTick << " ticks (" << r.finishTime << " s)";
+      if (r.finishTick != r.ticks)
+        std::cout << ", " << r.ticks - r.finishTick << " ticks of input after the finish";
+      std::cout << std::endl;
+    } else {
+      std::cout << "did not finish (" << r.ticks << " ticks)" << std::endl;
+    }
+  }
+  std::cout << finished << "/" << demos.size() << " finished, " << broken << " unreadable, " << rejected << " rejected, "
+            << ticks << " ticks in " << seconds << " s on " << threads << " threads" << std::endl;
+  return 0;
+}
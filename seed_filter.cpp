@@ -0,0 +1,162 @@
+// Generates a range of seeds on all cores and writes the ones whose courses
+// match the given filters, for picking daily and weekly maps. Only course
+// statistics are computed, platform lists are never built.
+//
+// usage: SeedFilter [-j threads] [--start S] [--count N] [-o file] [--reachable] [filters]
+//
+// --reachable drops seeds whose finish can't be reached with the default
+// physics, see ReachabilityAnalyzer.
+//
+// Filters take a range "min:max", either end can be left out:
+//   --platforms  number of platforms
+//   --length     path length through the platform centers
+//   --flips      direction changes of the spiral
+//   --drop       height from the first platform to the last
+//   --size-x     bounding box of the platform centers along x
+//   --size-z     and along z
+// Lengths are in world units. Matches are written as one line per seed.
+
+#include "include/course.h"
+#include "include/reachability.h"
+#include "include/simulation.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <string>
+#include <thread>
+#include <vector>
+
+struct Range {
+  float min = -std::numeric_limits<float>::infinity();
+  float max = std::numeric_limits<float>::infinity();
+
+  bool contains(float v) const { return v >= min && v <= max; }
+};
+
+// "min:max", "min:" or ":max"
+bool parse_range(const std::string &text, Range &range) {
+  size_t colon = text.find(':');
+  if (colon == std::string::npos) return false;
+  std::string lo = text.substr(0, colon);
+  std::string hi = text.substr(colon + 1);
+  char *end;
+  if (!lo.empty()) {
+    range.min = std::strtof(lo.c_str(), &end);
+    if (*end) return false;
+  }
+  if (!hi.empty()) {
+    range.max = std::strtof(hi.c_str(), &end);
+    if (*end) return false;
+  }
+  return true;
+}
+
+struct Filter {
+  Range platforms, length, flips, drop, sizeX, sizeZ;
+
+  bool matches(const CourseStats &stats) const {
+    glm::vec3 size = stats.bounds.max - stats.bounds.min;
+    return platforms.contains(stats.platforms) && length.contains(stats.length)
+      && flips.contains(stats.flips) && drop.contains(stats.drop)
+      && sizeX.contains(size.x) && sizeZ.contains(size.z);
+  }
+};
+
+struct Match {
+  uint64_t seed;
+  CourseStats stats;
+};
+
+int main(int argc, char **argv) {
+  unsigned threads = std::max(1u, std::thread::hardware_concurrency());
+  uint64_t start = 0;
+  uint64_t count = 1000000;
+  const char *outPath = nullptr;
+  bool reachable = false;
+  Filter filter;
+  for (int i = 1; i < argc; ++i) {
+    std::string arg = argv[i];
+    Range *range = arg == "--platforms" ? &filter.platforms
+      : arg == "--length" ? &filter.length
+      : arg == "--flips" ? &filter.flips
+      : arg == "--drop" ? &filter.drop
+      : arg == "--size-x" ? &filter.sizeX
+      : arg == "--size-z" ? &filter.sizeZ
+      : nullptr;
+    if (range && i + 1 < argc && parse_range(argv[i + 1], *range))
+      ++i;
+    else if (arg == "-j" && i + 1 < argc)
+      threads = std::max(1, std::atoi(argv[++i]));
+    else if (arg == "--start" && i + 1 < argc)
+      start = std::strtoull(argv[++i], nullptr, 10);
+    else if (arg == "--count" && i + 1 < argc)
+      count = std::strtoull(argv[++i], nullptr, 10);
+    else if (arg == "-o" && i + 1 < argc)
+      outPath = argv[++i];
+    else if (arg == "--reachable")
+      reachable = true;
+    else {
+      std::cout << "usage: " << argv[0] << " [-j threads] [--start S] [--count N] [-o file] [--reachable]\n"
+                << "       [--platforms min:max] [--length min:max] [--flips min:max]\n"
+                << "       [--drop min:max] [--size-x min:max] [--size-z min:max]" << std::endl;
+      return 1;
+    }
+  }
+
+  // seeds are handed out in chunks off a shared counter, each worker keeps
+  // its own matches and they're merged once at the end
+  const uint64_t chunk = 4096;
+  CourseParams params;
+  PhysicsParams physics;
+  std::atomic<uint64_t> next(0);
+  std::vector<std::vector<Match>> matches(threads);
+  auto begin = std::chrono::steady_clock::now();
+  std::vector<std::thread> pool;
+  for (unsigned t = 0; t < threads; ++t) {
+    pool.emplace_back([&, t]() {
+      ReachabilityAnalyzer analyzer(physics, params);
+      for (uint64_t first = next.fetch_add(chunk); first < count; first = next.fetch_add(chunk)) {
+        uint64_t last = std::min(first + chunk, count);
+        for (uint64_t i = first; i < last; ++i) {
+          CourseStats stats = course_stats(start + i, params);
+          // the stats are cheaper, only analyze what they let through
+          if (filter.matches(stats) && (!reachable || analyzer.analyze(start + i)))
+            matches[t].push_back(Match{start + i, stats});
+        }
+      }
+    });
+  }
+  for (auto &thread : pool) thread.join();
+  double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+
+  std::vector<Match> all;
+  for (auto &m : matches) all.insert(all.end(), m.begin(), m.end());
+  std::sort(all.begin(), all.end(), [](const Match &a, const Match &b) { return a.seed < b.seed; });
+
+  std::ofstream file;
+  if (outPath) {
+    file.open(outPath);
+    if (!file) {
+      std::cout << "failed to write " << outPath << std::endl;
+      return 1;
+    }
+  }
+  std::ostream &out = outPath ? file : std::cout;
+  out << "# seed platforms length flips drop size-x size-z\n";
+  for (const Match &m : all) {
+    glm::vec3 size = m.stats.bounds.max - m.stats.bounds.min;
+    out << m.seed << " " << m.stats.platforms << " " << m.stats.length << " " << m.stats.flips << " "
+        << m.stats.drop << " " << size.x << " " << size.z << "\n";
+  }
+  out.flush();
+
+  std::cerr << all.size() << "/" << count << " seeds matched in " << seconds << " s on " << threads
+            << " threads (" << (seconds > 0.0 ? count / seconds : 0.0) << " seeds/s)" << std::endl;
+  return 0;
+}
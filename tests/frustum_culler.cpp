@@ -0,0 +1,66 @@
+// Checks FrustumCuller's vector and threaded paths against a plain scalar
+// cull of the same boxes, at sizes around the register width and around
+// parallelThreshold.
+
+#include "include/frustum.h"
+#include "include/course.h"
+#include "include/glm/gtc/matrix_transform.hpp"
+
+#include <cstdint>
+#include <iostream>
+#include <vector>
+
+// one box at a time, summed in the same order as FrustumCuller
+std::vector<uint32_t> reference_cull(const Frustum &frustum, const std::vector<AABB> &boxes) {
+  std::vector<uint32_t> visible;
+  for (size_t i = 0; i < boxes.size(); ++i) {
+    glm::vec3 c = (boxes[i].min + boxes[i].max) * 0.5f;
+    glm::vec3 e = (boxes[i].max - boxes[i].min) * 0.5f;
+    bool inside = true;
+    for (const glm::vec4 &plane : frustum.planes) {
+      float d = (plane.x*c.x + plane.y*c.y) + (plane.z*c.z + plane.w);
+      float r = (std::abs(plane.x)*e.x + std::abs(plane.y)*e.y) + std::abs(plane.z)*e.z;
+      inside = inside && d + r >= 0.0f;
+    }
+    if (inside) visible.push_back(static_cast<uint32_t>(i));
+  }
+  return visible;
+}
+
+int main() {
+  const size_t n = FrustumCuller::parallelThreshold;
+  const size_t sizes[] = {0, 1, 3, 4, 5, 7, 8, 9, 13, 1000, 1001, n - 1, n, n + 1, 3*n + 5};
+  const unsigned threadCounts[] = {1, 2, 3, 8};
+  CourseRng rng(42);
+  int failures = 0;
+  for (size_t size : sizes) {
+    std::vector<AABB> boxes(size);
+    for (AABB &box : boxes) {
+      glm::vec3 center(rng.uniform(-60.0f, 60.0f), rng.uniform(-60.0f, 60.0f), rng.uniform(-60.0f, 60.0f));
+      glm::vec3 half(rng.uniform(0.05f, 2.0f), rng.uniform(0.05f, 2.0f), rng.uniform(0.05f, 2.0f));
+      box = aabb_from_center(center, half);
+    }
+    FrustumCuller culler;
+    culler.set_boxes(boxes.data(), boxes.size());
+    std::vector<uint32_t> visible;
+    for (unsigned threads : threadCounts) {
+      culler.threads = threads;
+      // a few views so the same workers get handed several jobs
+      for (int view = 0; view < 4; ++view) {
+        float yaw = rng.uniform(0.0f, 2.0f * static_cast<float>(M_PI));
+        glm::vec3 eye(rng.uniform(-20.0f, 20.0f), rng.uniform(-20.0f, 20.0f), rng.uniform(-20.0f, 20.0f));
+        glm::mat4 viewMatrix = glm::lookAt(eye, eye + glm::vec3(std::cos(yaw), 0.2f, std::sin(yaw)), glm::vec3(0.0f, 1.0f, 0.0f));
+        glm::mat4 projection = glm::perspective(glm::radians(90.0f), 800.0f / 600.0f, 0.1f, 100.0f);
+        Frustum frustum = frustum_from_matrix(projection * viewMatrix);
+        size_t count = culler.cull(frustum, visible);
+        if (count != visible.size() || visible != reference_cull(frustum, boxes)) {
+          std::cout << "mismatch with " << size << " boxes on " << threads << " threads" << std::endl;
+          ++failures;
+        }
+      }
+    }
+  }
+  if (!failures)
+    std::cout << "all culls match the reference" << std::endl;
+  return failures ? 1 : 0;
+}
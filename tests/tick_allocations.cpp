@@ -0,0 +1,43 @@
+// Runs the simulation on a generated course under a counting allocator and
+// fails if any tick after warm-up touches the heap.
+
+#include "include/alloc_counter.h"
+#include "include/course.h"
+#include "include/demo.h"
+#include "include/simulation.h"
+
+#include <cstdint>
+#include <iostream>
+
+int main() {
+  const uint64_t warmupTicks = 1000;
+  const uint64_t ticks = 200000;
+  PhysicsParams physics;
+  Course course = generate_course(12345, CourseParams(), physics.playerSize);
+  Simulation sim(course, physics);
+
+  // holds forward and jump while turning, which lands on platforms, falls
+  // off them and respawns, so every path through a tick gets run
+  TickInput input;
+  input.forward = true;
+  input.jump = true;
+  uint64_t respawns = 0;
+  size_t allocationsBefore = 0;
+  for (uint64_t tick = 0; tick < warmupTicks + ticks; ++tick) {
+    if (tick == warmupTicks)
+      allocationsBefore = heapAllocations;
+    input.yaw += 0.5f;
+    quantize_angles(input);
+    if (sim.tick(input) != TickEvent::None)
+      ++respawns;
+  }
+  size_t tickAllocations = heapAllocations - allocationsBefore;
+
+  std::cout << ticks << " ticks, " << respawns << " respawns or finishes, "
+            << tickAllocations << " heap allocations" << std::endl;
+  if (respawns == 0) {
+    std::cout << "the run never respawned, it doesn't cover every path" << std::endl;
+    return 1;
+  }
+  return tickAllocations == 0 ? 0 : 1;
+}